@@ -0,0 +1,110 @@
+// MD_AD9833 frequency chirp example
+//
+// Repeatedly sweeps the output frequency from CHIRP_START to CHIRP_END
+// using chirpStep() called from a timer interrupt, then prints the
+// achieved update rate and the timing error on the Serial Monitor.
+//
+// On AVR processors Timer1 runs the chirp steps. On other architectures
+// the steps are run from loop() using micros(), which works but has
+// more timing error.
+//
+#include <MD_AD9833.h>
+#include <SPI.h>
+
+// Pins for SPI comm with the AD9833 IC
+const uint8_t PIN_DATA = 11;  ///< SPI Data pin number
+const uint8_t PIN_CLK = 13;  	///< SPI Clock pin number
+const uint8_t PIN_FSYNC = 10; ///< SPI Load pin number (FSYNC in AD9833 usage)
+
+MD_AD9833	AD(PIN_FSYNC);  // Hardware SPI
+// MD_AD9833	AD(PIN_DATA, PIN_CLK, PIN_FSYNC); // Arbitrary SPI pins
+
+// Chirp profile
+const float CHIRP_START = 1000.0;     ///< Start frequency in Hz
+const float CHIRP_END = 100000.0;     ///< End frequency in Hz
+const uint32_t CHIRP_STEPS = 5000;    ///< Number of steps in the chirp
+const uint32_t CHIRP_PERIOD = 100;    ///< Time between steps in microseconds
+const MD_AD9833::chirp_t CHIRP_TYPE = MD_AD9833::CHIRP_LINEAR;
+
+#if defined(__AVR__)
+ISR(TIMER1_COMPA_vect)
+{
+  AD.chirpStep();
+}
+
+void timerStart(uint32_t period)
+// Timer1 in CTC mode, prescaler 8 so 1 count is 0.5us at 16MHz
+{
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  OCR1A = (uint16_t)((period * (F_CPU / 1000000UL) / 8) - 1);
+  TCCR1B = bit(WGM12) | bit(CS11);
+  TIMSK1 = bit(OCIE1A);
+  interrupts();
+}
+
+void timerStop(void)
+{
+  TIMSK1 = 0;
+}
+
+bool chirpRunning(void)
+// The step counter is changed by the ISR, so read it atomically
+{
+  bool b;
+
+  noInterrupts();
+  b = AD.chirpRunning();
+  interrupts();
+
+  return(b);
+}
+#else
+void timerStart(uint32_t) {}
+void timerStop(void) {}
+#endif
+
+void setup(void)
+{
+  Serial.begin(57600);
+  Serial.print(F("\n[MD_AD9833 Chirp]"));
+  AD.begin();
+}
+
+void loop(void)
+{
+  if (!AD.chirpBegin(CHIRP_START, CHIRP_END, CHIRP_STEPS, CHIRP_PERIOD, CHIRP_TYPE))
+  {
+    Serial.print(F("\nInvalid chirp profile"));
+    while (true);
+  }
+  timerStart(CHIRP_PERIOD);
+
+#if defined(__AVR__)
+  while (chirpRunning())
+    ;   // the ISR does all the work
+#else
+  uint32_t timeLast = micros();
+
+  while (AD.chirpRunning())
+  {
+    if (micros() - timeLast >= CHIRP_PERIOD)
+    {
+      timeLast += CHIRP_PERIOD;
+      AD.chirpStep();
+    }
+  }
+#endif
+
+  timerStop();
+  AD.chirpEnd();
+
+  Serial.print(F("\nSteps: ")); Serial.print(AD.getChirpSteps());
+  Serial.print(F(" Rate: ")); Serial.print(AD.getChirpRate());
+  Serial.print(F("/s (requested ")); Serial.print(1000000.0 / CHIRP_PERIOD);
+  Serial.print(F("/s) Max error: ")); Serial.print(AD.getChirpError()); Serial.print(F("us"));
+
+  delay(1000);
+}
@@ -0,0 +1,76 @@
+// MD_AD9833 frequency conversion benchmark
+//
+// Compares calcFreq(), which converts a float frequency into a correctly
+// rounded frequency register value using integer operations, with the
+// float calculation used by earlier versions of the library.
+//
+// For each decade of frequency the average time per conversion and the
+// number of register values that differ are printed on the Serial Monitor.
+// No AD9833 needs to be connected.
+//
+#include <MD_AD9833.h>
+
+const uint32_t MCLK = 25000000UL;   ///< Reference clock frequency in Hz
+const uint16_t BENCH_COUNT = 1000;  ///< Conversions timed for each decade
+
+volatile float fIn;       ///< stops the compiler optimizing the calculations away
+volatile uint32_t regOut;
+
+uint32_t calcFloat(float f, uint32_t mClk)
+// The calculation used before version 1.4.0
+{
+  return (uint32_t)((f * 268435456.0 / mClk) + 0.5);
+}
+
+float testFreq(float decade, uint16_t i)
+// Spread the test frequencies over the decade
+{
+  return(decade * (1.0 + (9.0 * i) / BENCH_COUNT));
+}
+
+void setup(void)
+{
+  Serial.begin(57600);
+  Serial.print(F("\n[MD_AD9833 FreqBench]"));
+  Serial.print(F("\nFrom\tcalcFreq\tfloat\tdiffer"));
+
+  for (float decade = 0.1; decade < MCLK / 2; decade *= 10)
+  {
+    uint32_t t, tInt, tFloat;
+    uint16_t differ = 0;
+
+    t = micros();
+    for (uint16_t i = 0; i < BENCH_COUNT; i++)
+    {
+      fIn = testFreq(decade, i);
+      regOut = MD_AD9833::calcFreq(fIn, MCLK);
+    }
+    tInt = micros() - t;
+
+    t = micros();
+    for (uint16_t i = 0; i < BENCH_COUNT; i++)
+    {
+      fIn = testFreq(decade, i);
+      regOut = calcFloat(fIn, MCLK);
+    }
+    tFloat = micros() - t;
+
+    for (uint16_t i = 0; i < BENCH_COUNT; i++)
+    {
+      float f = testFreq(decade, i);
+
+      if (MD_AD9833::calcFreq(f, MCLK) != calcFloat(f, MCLK))
+        differ++;
+    }
+
+    Serial.print(F("\n")); Serial.print(decade, 1);
+    Serial.print(F("\t")); Serial.print((float)tInt / BENCH_COUNT);
+    Serial.print(F("us\t")); Serial.print((float)tFloat / BENCH_COUNT);
+    Serial.print(F("us\t")); Serial.print(differ);
+  }
+  Serial.print(F("\n"));
+}
+
+void loop(void)
+{
+}
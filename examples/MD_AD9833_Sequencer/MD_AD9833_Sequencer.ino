@@ -0,0 +1,169 @@
+// MD_AD9833 sequencer example
+//
+// At startup a benchmark measures the time taken by each sequencer
+// instruction and the jitter between runs, printed on the Serial Monitor.
+//
+// The loop then runs an FSK burst program stored in PROGMEM. A different
+// program can be sent over the serial port, as a 2 byte length (LSB first)
+// followed by the program bytes, and it is then run instead of the built
+// in program. The program below, and binary programs for the serial port,
+// are created from scripts by the AD9833_SeqAsm tool in the library
+// extras folder.
+//
+#include <MD_AD9833.h>
+#include <SPI.h>
+
+// Pins for SPI comm with the AD9833 IC
+const uint8_t PIN_DATA = 11;  ///< SPI Data pin number
+const uint8_t PIN_CLK = 13;  	///< SPI Clock pin number
+const uint8_t PIN_FSYNC = 10; ///< SPI Load pin number (FSYNC in AD9833 usage)
+
+MD_AD9833	AD(PIN_FSYNC);  // Hardware SPI
+// MD_AD9833	AD(PIN_DATA, PIN_CLK, PIN_FSYNC); // Arbitrary SPI pins
+
+#define ARRAY_SIZE(a) (sizeof(a)/sizeof((a)[0]))
+
+// FSK burst, alternating 1kHz and 2kHz every 500us 10 times, then sleep.
+//  freq 0 1000
+//  freq 1 2000
+//  phase 0 0
+//  phase 1 90
+//  mode sine
+//  loop 10
+//    fsel 0
+//    wait 500
+//    fsel 1
+//    wait 500
+//  next
+//  sleep all
+const uint8_t seqProgram[] PROGMEM =
+{
+  0x10, 0xf1, 0x29, 0x00, 0x00, 0x11, 0xe3, 0x53, 0x00, 0x00, 0x20, 0x00,
+  0x00, 0x21, 0x00, 0x04, 0x51, 0x70, 0x0a, 0x00, 0x30, 0x60, 0xf4, 0x01,
+  0x00, 0x00, 0x31, 0x60, 0xf4, 0x01, 0x00, 0x00, 0x80, 0xa3, 0x00
+};
+
+const uint16_t PROG_SIZE = 128;   ///< RAM buffer size for serial programs
+uint8_t progRAM[PROG_SIZE];       ///< Program received from the serial port
+uint16_t progLen = 0;             ///< Length of the RAM program
+bool useRAM = false;              ///< true when the RAM program is valid
+
+// Benchmark parameters
+const uint16_t BENCH_COUNT = 100;   ///< Instructions in each benchmark run
+const uint8_t BENCH_RUNS = 20;      ///< Benchmark runs for each instruction
+
+void benchmark(const __FlashStringHelper* name, const uint8_t* instr, uint8_t len, uint32_t expect)
+// Time BENCH_COUNT executions of the instruction in a loop and take
+// off the time for an empty loop. Jitter is the spread of the run times
+// and the error is the time of the slowest run over the expected time.
+{
+  static uint32_t loopTime = 0;
+  uint8_t prog[16];
+  uint8_t n = 0;
+  uint32_t tMin = 0xffffffff, tMax = 0, tSum = 0;
+
+  prog[n++] = MD_AD9833::SEQ_LOOP;
+  prog[n++] = BENCH_COUNT & 0xff;
+  prog[n++] = BENCH_COUNT >> 8;
+  for (uint8_t i = 0; i < len; i++)
+    prog[n++] = instr[i];
+  prog[n++] = MD_AD9833::SEQ_NEXT;
+  prog[n++] = MD_AD9833::SEQ_END;
+
+  for (uint8_t r = 0; r < BENCH_RUNS; r++)
+  {
+    uint32_t t = micros();
+
+    AD.runSequence(prog, n, false);
+    t = micros() - t;
+    tSum += t;
+    if (t < tMin) tMin = t;
+    if (t > tMax) tMax = t;
+  }
+
+  if (len == 0)   // empty loop overhead
+  {
+    loopTime = tSum / BENCH_RUNS;
+    return;
+  }
+
+  Serial.print(F("\n")); Serial.print(name);
+  Serial.print(F("\t")); Serial.print((float)((tSum / BENCH_RUNS) - loopTime) / BENCH_COUNT);
+  Serial.print(F("us\tjitter ")); Serial.print(tMax - tMin);
+  Serial.print(F("us"));
+  if (expect != 0)
+  {
+    Serial.print(F("\terror ")); Serial.print((int32_t)(tMax - loopTime - expect));
+    Serial.print(F("us"));
+  }
+}
+
+void runBenchmark(void)
+{
+  const uint8_t freq[] = { MD_AD9833::SEQ_FREQ | 0, 0xf1, 0x29, 0x00, 0x00 };
+  const uint8_t phase[] = { MD_AD9833::SEQ_PHASE | 0, 0x00, 0x04 };
+  const uint8_t fsel[] = { MD_AD9833::SEQ_SELFREQ | 1 };
+  const uint8_t mode[] = { MD_AD9833::SEQ_MODE | MD_AD9833::MODE_SINE };
+  const uint8_t wait[] = { MD_AD9833::SEQ_WAIT, 100, 0, 0, 0 };
+
+  Serial.print(F("\n\nInstruction latency (average of "));
+  Serial.print(BENCH_RUNS); Serial.print(F(" runs)"));
+
+  benchmark(nullptr, nullptr, 0, 0);
+  benchmark(F("FREQ"), freq, ARRAY_SIZE(freq), 0);
+  benchmark(F("PHASE"), phase, ARRAY_SIZE(phase), 0);
+  benchmark(F("SELFREQ"), fsel, ARRAY_SIZE(fsel), 0);
+  benchmark(F("MODE"), mode, ARRAY_SIZE(mode), 0);
+  benchmark(F("WAIT 100"), wait, ARRAY_SIZE(wait), BENCH_COUNT * 100UL);
+  Serial.print(F("\n"));
+}
+
+void receiveProgram(void)
+// Receive a length prefixed program into RAM
+{
+  uint16_t len, i = 0;
+  uint32_t timeout = millis();
+
+  while (Serial.available() < 2)
+    if (millis() - timeout > 1000) return;
+  len = Serial.read();
+  len |= Serial.read() << 8;
+
+  while (i < len && millis() - timeout < 2000)
+  {
+    if (Serial.available())
+    {
+      uint8_t c = Serial.read();
+
+      if (i < PROG_SIZE) progRAM[i] = c;
+      i++;
+    }
+  }
+
+  useRAM = (i == len && len <= PROG_SIZE);
+  progLen = len;
+  Serial.print(useRAM ? F("\nProgram received ") : F("\nProgram error "));
+  Serial.print(len);
+}
+
+void setup(void)
+{
+  Serial.begin(57600);
+  Serial.print(F("\n[MD_AD9833 Sequencer]"));
+  AD.begin();
+  runBenchmark();
+}
+
+void loop(void)
+{
+  if (Serial.available())
+    receiveProgram();
+
+  if (!(useRAM ? AD.runSequence(progRAM, progLen, false) : AD.runSequence(seqProgram, sizeof(seqProgram))))
+  {
+    Serial.print(F("\nInvalid program"));
+    useRAM = false;
+  }
+
+  delay(100);
+}
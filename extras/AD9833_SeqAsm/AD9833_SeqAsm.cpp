@@ -0,0 +1,308 @@
+/*
+AD9833_SeqAsm - Host tool to assemble MD_AD9833 sequencer programs.
+
+See the main MD_AD9833 library header file for full information.
+
+Converts a text script into a program for MD_AD9833::runSequence().
+Frequencies and phases are converted into AD9833 register values here,
+rounded the same way as the library, so the sequencer does no
+calculations when it runs. The output is either a header file with
+a PROGMEM array or a binary file that can be sent to the Arduino.
+
+Build with any C++11 compiler, for example
+  g++ -O2 -std=c++11 AD9833_SeqAsm.cpp -o AD9833_SeqAsm
+
+Usage
+  AD9833_SeqAsm [-b] [-n name] script [output]
+
+  -b       write a binary file instead of a header file
+  -n name  name of the PROGMEM array [seqProgram]
+  output   output file name [script name with .h or .bin]
+
+Script format
+  One instruction per line, ';' or '#' start a comment, and channels
+  are 0 or 1. Instructions are
+    clock hz            reference clock for frequency conversion [25000000]
+    freq chan hz        set frequency register (eg, freq 0 1000.5)
+    phase chan degrees  set phase register (eg, phase 1 90)
+    fsel chan           select the output frequency register
+    psel chan           select the output phase register
+    mode m              output mode off, sine, square1, square2 or triangle
+    wait us             wait microseconds from the end of the last wait
+    loop n              repeat up to the matching next n times (0 is forever)
+    next                end of loop
+    reset [hold]        reset the AD9833, holding the reset if 'hold'
+    sleep s             power state none, dac, mclk or all (not after mode off)
+    end                 end of program (added if missing)
+*/
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// These must match MD_AD9833::seqOp_t and the library defaults
+enum seqOp_t
+{
+  SEQ_END = 0x00,
+  SEQ_FREQ = 0x10,
+  SEQ_PHASE = 0x20,
+  SEQ_SELFREQ = 0x30,
+  SEQ_SELPHASE = 0x40,
+  SEQ_MODE = 0x50,
+  SEQ_WAIT = 0x60,
+  SEQ_LOOP = 0x70,
+  SEQ_NEXT = 0x80,
+  SEQ_RESET = 0x90,
+  SEQ_SLEEP = 0xa0,
+};
+
+const uint32_t AD_2POW28 = 1UL << 28;
+const unsigned AD_SEQ_LOOP_DEPTH = 4;
+
+const char* modeNames[] = { "off", "sine", "square1", "square2", "triangle" };
+const char* sleepNames[] = { "none", "dac", "mclk", "all" };
+
+struct source_t
+{
+  const char* name;
+  unsigned line;
+};
+
+void error(const source_t &src, const char* msg, const char* arg = "")
+{
+  fprintf(stderr, "%s:%u: %s%s\n", src.name, src.line, msg, arg);
+  exit(1);
+}
+
+uint32_t calcFreq(double f, uint32_t mClk)
+// Register value rounded to nearest, as MD_AD9833::calcFreqmHz()
+{
+  uint64_t mHz = (uint64_t)(f * 1000.0 + 0.5);
+  uint64_t d = 1000ULL * mClk;
+
+  return((uint32_t)(((mHz << 28) + d / 2) / d));
+}
+
+uint16_t calcPhase(double deg)
+// Register value as MD_AD9833::calcPhase()
+{
+  deg = fmod(deg, 360.0);
+  if (deg < 0) deg += 360.0;
+
+  return((uint16_t)((deg * 4096.0 / 360.0) + 0.5) & 0xfff);
+}
+
+void emit(std::vector<uint8_t> &prog, uint8_t op, uint32_t data = 0, uint8_t len = 0)
+{
+  prog.push_back(op);
+  for (uint8_t i = 0; i < len; i++)
+    prog.push_back((data >> (8 * i)) & 0xff);
+}
+
+uint8_t getChan(const source_t &src, const char* s)
+{
+  if (s == nullptr || (strcmp(s, "0") != 0 && strcmp(s, "1") != 0))
+    error(src, "channel must be 0 or 1");
+
+  return(s[0] - '0');
+}
+
+double getNumber(const source_t &src, const char* s, double min, double max)
+{
+  char* end;
+  double v;
+
+  if (s == nullptr) error(src, "missing value");
+  v = strtod(s, &end);
+  if (*end != '\0' || v < min || v > max) error(src, "invalid value ", s);
+
+  return(v);
+}
+
+uint8_t getName(const source_t &src, const char* s, const char* names[], uint8_t count)
+{
+  if (s != nullptr)
+    for (uint8_t i = 0; i < count; i++)
+      if (strcmp(s, names[i]) == 0) return(i);
+  error(src, "invalid name ", s == nullptr ? "" : s);
+
+  return(0);
+}
+
+std::vector<uint8_t> assemble(const char* name)
+{
+  FILE* f = fopen(name, "r");
+  source_t src = { name, 0 };
+  std::vector<uint8_t> prog;
+  uint32_t mClk = 25000000;
+  unsigned loopLevel = 0;
+  bool ended = false;
+  bool modeOff = false;
+  char line[256];
+
+  if (f == nullptr)
+  {
+    fprintf(stderr, "Cannot read script %s\n", name);
+    exit(1);
+  }
+
+  while (fgets(line, sizeof(line), f) != nullptr)
+  {
+    src.line++;
+    line[strcspn(line, ";#\r\n")] = '\0';
+
+    const char* cmd = strtok(line, " \t");
+    const char* a1 = strtok(nullptr, " \t");
+    const char* a2 = strtok(nullptr, " \t");
+
+    if (cmd == nullptr) continue;
+    if (ended) error(src, "instruction after end");
+
+    if (strcmp(cmd, "clock") == 0)
+      mClk = (uint32_t)getNumber(src, a1, 1, 4294967295.0);
+    else if (strcmp(cmd, "freq") == 0)
+    {
+      uint8_t c = getChan(src, a1);
+      double hz = getNumber(src, a2, 0, mClk / 2.0);
+      emit(prog, SEQ_FREQ | c, calcFreq(hz, mClk) & (AD_2POW28 - 1), 4);
+    }
+    else if (strcmp(cmd, "phase") == 0)
+    {
+      uint8_t c = getChan(src, a1);
+      emit(prog, SEQ_PHASE | c, calcPhase(getNumber(src, a2, -1e6, 1e6)), 2);
+    }
+    else if (strcmp(cmd, "fsel") == 0)
+      emit(prog, SEQ_SELFREQ | getChan(src, a1));
+    else if (strcmp(cmd, "psel") == 0)
+      emit(prog, SEQ_SELPHASE | getChan(src, a1));
+    else if (strcmp(cmd, "mode") == 0)
+    {
+      uint8_t m = getName(src, a1, modeNames, 5);
+
+      modeOff = (m == 0);
+      emit(prog, SEQ_MODE | m);
+    }
+    else if (strcmp(cmd, "wait") == 0)
+      emit(prog, SEQ_WAIT, (uint32_t)getNumber(src, a1, 0, 4294967295.0), 4);
+    else if (strcmp(cmd, "loop") == 0)
+    {
+      if (++loopLevel > AD_SEQ_LOOP_DEPTH) error(src, "loops nested too deep");
+      emit(prog, SEQ_LOOP, (uint32_t)getNumber(src, a1, 0, 65535), 2);
+    }
+    else if (strcmp(cmd, "next") == 0)
+    {
+      if (loopLevel == 0) error(src, "next without loop");
+      loopLevel--;
+      emit(prog, SEQ_NEXT);
+    }
+    else if (strcmp(cmd, "reset") == 0)
+    {
+      if (a1 != nullptr && strcmp(a1, "hold") != 0) error(src, "invalid reset option ", a1);
+      emit(prog, SEQ_RESET | (a1 != nullptr ? 1 : 0));
+    }
+    else if (strcmp(cmd, "sleep") == 0)
+    {
+      if (modeOff) error(src, "sleep is invalid after mode off");
+      emit(prog, SEQ_SLEEP | getName(src, a1, sleepNames, 4));
+    }
+    else if (strcmp(cmd, "end") == 0)
+      ended = true;
+    else
+      error(src, "unknown instruction ", cmd);
+  }
+  fclose(f);
+
+  if (loopLevel != 0) error(src, "loop without next");
+  emit(prog, SEQ_END);
+
+  return(prog);
+}
+
+bool writeHeader(const char* name, const char* array, const std::vector<uint8_t> &prog, const char* script)
+{
+  FILE* f = fopen(name, "w");
+
+  if (f == nullptr) return(false);
+
+  fprintf(f, "// MD_AD9833 sequencer program assembled by AD9833_SeqAsm from %s\n", script);
+  fprintf(f, "// Run with AD.runSequence(%s, sizeof(%s));\n", array, array);
+  fprintf(f, "#pragma once\n\n");
+  fprintf(f, "const uint8_t %s[] PROGMEM =\n{", array);
+  for (size_t i = 0; i < prog.size(); i++)
+    fprintf(f, "%s0x%02x", (i == 0) ? "\n  " : (i % 12 == 0) ? ",\n  " : ", ", prog[i]);
+  fprintf(f, "\n};\n");
+  fclose(f);
+
+  return(true);
+}
+
+bool writeBinary(const char* name, const std::vector<uint8_t> &prog)
+{
+  FILE* f = fopen(name, "wb");
+  bool ok;
+
+  if (f == nullptr) return(false);
+  ok = (fwrite(prog.data(), 1, prog.size(), f) == prog.size());
+  fclose(f);
+
+  return(ok);
+}
+
+void usage(void)
+{
+  fprintf(stderr, "usage: AD9833_SeqAsm [-b] [-n name] script [output]\n");
+  exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+  bool binary = false;
+  const char* array = "seqProgram";
+  const char* script = nullptr;
+  std::string output;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-b") == 0)
+      binary = true;
+    else if (strcmp(argv[i], "-n") == 0)
+    {
+      if (++i >= argc) usage();
+      array = argv[i];
+    }
+    else if (script == nullptr)
+      script = argv[i];
+    else if (output.empty())
+      output = argv[i];
+    else
+      usage();
+  }
+  if (script == nullptr) usage();
+
+  if (output.empty())
+  {
+    size_t dir, ext;
+
+    output = script;
+    dir = output.find_last_of("/\\");
+    ext = output.find_last_of('.');
+    if (ext != std::string::npos && (dir == std::string::npos || ext > dir))
+      output.erase(ext);
+    output += (binary ? ".bin" : ".h");
+  }
+
+  std::vector<uint8_t> prog = assemble(script);
+  bool ok = binary ? writeBinary(output.c_str(), prog) : writeHeader(output.c_str(), array, prog, script);
+
+  if (!ok)
+  {
+    fprintf(stderr, "Cannot write output file %s\n", output.c_str());
+    return(1);
+  }
+  fprintf(stderr, "%zu bytes written to %s\n", prog.size(), output.c_str());
+
+  return(0);
+}
@@ -0,0 +1,543 @@
+/*
+AD9833_SpurTable - Host tool to create MD_AD9833 tuning tables.
+
+See the main MD_AD9833 library header file for full information.
+
+The AD9833 keeps a 28-bit phase accumulator, but only the top 12 bits
+are used to look up the sine ROM, and the ROM output drives a 10-bit DAC.
+The truncated accumulator bits produce spurious output (spurs) whose level
+depends on the frequency register value. Register values next to the one
+calculated for a frequency can have much better Spurious Free Dynamic
+Range (SFDR) for an output frequency error of a fraction of a Hz.
+
+This tool models the accumulator, sine ROM and DAC, works out the SFDR
+of the register values around each target frequency using an FFT of the
+modelled output, and writes a header file containing a tuning table
+for MD_AD9833::setTuningTable(). The FFT size is increased for low
+target frequencies so that the fundamental is clear of the DC bins.
+Table entries are keyed by the register value calculated by both
+MD_AD9833::setFrequency() and MD_AD9833::setFrequencymHz(). Candidates are analyzed in parallel
+on all processor cores and results are saved in a cache file so that
+they are not worked out again for later runs.
+
+Build with any C++11 compiler, for example
+  g++ -O2 -std=c++11 -pthread AD9833_SpurTable.cpp -o AD9833_SpurTable
+
+Usage
+  AD9833_SpurTable [options] freq [freq ...]
+
+  freq  target frequencies in Hz (eg, 1000 or 1234567.125)
+
+Options
+  -c clk    AD9833 reference clock frequency in Hz [25000000]
+  -n bits   minimum FFT size as a power of 2, up to 24 [14]
+  -w words  number of register values either side of the calculated value to check [8]
+  -e hz     maximum allowed frequency error in Hz [1.0]
+  -g db     minimum SFDR improvement to make a table entry [3.0]
+  -j jobs   number of worker threads [all cores]
+  -m mib    memory limit for the FFT buffers in MiB, fewer threads are used for large FFTs [2048]
+  -f file   file of target frequencies, one per line
+  -k file   cache file [AD9833_SpurTable.cache]
+  -o file   output header file [AD9833_TuneTable.h]
+
+The table created is only valid for the specified reference clock frequency.
+*/
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint32_t AD_2POW28 = 1UL << 28; // frequency register range
+const uint8_t  AD_PHASE_BITS = 12;    // accumulator bits used for the sine ROM
+const uint8_t  AD_DAC_BITS = 10;      // DAC resolution
+const uint8_t  FFT_MAX_BITS = 24;     // largest FFT size as a power of 2
+const size_t   FFT_GUARD = 6;         // main lobe half width of the window in bins
+const size_t   FFT_MIN_BIN = 3 * FFT_GUARD; // lowest fundamental bin clear of the DC bins
+const double   PI = 3.14159265358979323846;
+
+// Run parameters
+struct config_t
+{
+  uint32_t mClk = 25000000;
+  uint8_t  fftBits = 14;
+  uint32_t width = 8;
+  double   maxError = 1.0;
+  double   minGain = 3.0;
+  unsigned jobs = 0;
+  size_t   memLimit = 2048;    // MiB
+  std::string cacheFile = "AD9833_SpurTable.cache";
+  std::string outFile = "AD9833_TuneTable.h";
+  std::vector<double> targets;
+};
+
+// Result for one target frequency
+struct target_t
+{
+  double   freq;     // requested frequency
+  uint32_t reg;      // register value calculated by setFrequency()
+  uint32_t regmHz;   // register value calculated by setFrequencymHz()
+  uint8_t  fftBits;  // FFT size used for the SFDR
+  uint32_t best;     // register value with the best SFDR
+  double   sfdrReg;  // SFDR of reg
+  double   sfdrBest; // SFDR of best
+};
+
+uint32_t calcFreq(double f, uint32_t mClk)
+// Register value for the frequency passed to setFrequency() as a float,
+// as MD_AD9833::calcFreq(). The float is exactly m * 2^e, so the value 
+// m * 2^(e+28) / mClk is rounded to nearest using integers.
+{
+  float fl = (float)f;
+  int   e;
+  uint64_t m, d = mClk, q;
+
+  if (fl <= 0) return(0);
+  if (mClk < 0x800000UL)    // the library uses float arithmetic here
+    return((uint32_t)((double)(fl * (float)AD_2POW28 / (float)mClk) + 0.5));
+
+  m = (uint64_t)ldexp(frexp(fl, &e), 24);   // 24 bit mantissa
+  e += 28 - 24;
+  if (e >= 0)
+    m <<= e;                  // fl < 2^24 so m < 2^52
+  else if (e >= -31)
+    d <<= -e;
+  else
+    return(0);
+  q = m / d;
+  if (m % d >= d - m % d) q++;  // round half up
+
+  return(q >= AD_2POW28 ? AD_2POW28 - 1 : (uint32_t)q);
+}
+
+uint32_t calcFreqmHz(double f, uint32_t mClk)
+// Register value for the frequency in whole millihertz, rounded to 
+// nearest as MD_AD9833::calcFreqmHz()
+{
+  uint64_t mHz = (uint64_t)(f * 1000.0 + 0.5);
+  uint64_t d = 1000ULL * mClk;
+  uint64_t q = ((mHz << 28) + d / 2) / d;    // mHz < 2^35 so no overflow
+
+  return(q >= AD_2POW28 ? AD_2POW28 - 1 : (uint32_t)q);
+}
+
+uint8_t fftSize(uint32_t reg, uint8_t minBits)
+// Smallest FFT size from minBits up that puts the fundamental at or 
+// above FFT_MIN_BIN, or 0 if the largest FFT size is not enough.
+{
+  for (uint8_t bits = minBits; bits <= FFT_MAX_BITS; bits++)
+    if ((((uint64_t)reg << bits) >> 28) >= FFT_MIN_BIN)
+      return(bits);
+
+  return(0);
+}
+
+void fft(std::vector<std::complex<double>> &x)
+// In place iterative radix-2 FFT, size must be a power of 2
+{
+  const size_t n = x.size();
+
+  for (size_t i = 1, j = 0; i < n; i++)
+  {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j) std::swap(x[i], x[j]);
+  }
+
+  for (size_t len = 2; len <= n; len <<= 1)
+  {
+    const std::complex<double> wlen = std::polar(1.0, -2 * PI / len);
+
+    for (size_t i = 0; i < n; i += len)
+    {
+      std::complex<double> w(1.0);
+
+      for (size_t k = 0; k < len / 2; k++)
+      {
+        std::complex<double> u = x[i + k];
+        std::complex<double> v = x[i + k + len / 2] * w;
+
+        x[i + k] = u + v;
+        x[i + k + len / 2] = u - v;
+        w *= wlen;
+      }
+    }
+  }
+}
+
+// FFT work space, kept by each worker thread so that it is only 
+// allocated again when a larger FFT size is needed
+struct fftBuffer_t
+{
+  std::vector<std::complex<double>> x;
+  std::vector<double> p;
+};
+
+size_t fftMemory(uint8_t fftBits)
+// Bytes used by an fftBuffer_t for the FFT size
+{
+  return(((size_t)1 << fftBits) * (sizeof(std::complex<double>) + sizeof(double) / 2));
+}
+
+double calcSFDR(uint32_t reg, uint8_t fftBits, fftBuffer_t &buf)
+// Model the AD9833 sine output for the register value and return the
+// SFDR in dB. The output is sampled once per MCLK cycle, so the result
+// does not depend on the clock frequency.
+{
+  const size_t n = (size_t)1 << fftBits;
+  const uint32_t dacMax = (1UL << AD_DAC_BITS) - 1;
+  const size_t guard = FFT_GUARD;
+  std::vector<std::complex<double>> &x = buf.x;
+  std::vector<double> &p = buf.p;
+  uint32_t acc = 0;
+
+  if (reg == 0) return(0.0);
+
+  x.resize(n);      // every element is written below
+  p.resize(n / 2);
+
+  for (size_t i = 0; i < n; i++)
+  {
+    // Phase accumulator, truncated phase, sine ROM and DAC
+    uint32_t phase = acc >> (28 - AD_PHASE_BITS);
+    double   s = sin(2 * PI * phase / (1UL << AD_PHASE_BITS));
+    uint32_t dac = (uint32_t)lround((s + 1.0) * dacMax / 2.0);
+
+    // 4 term Blackman-Harris window to keep leakage well below the spurs
+    double a = 2 * PI * i / n;
+    double w = 0.35875 - 0.48829 * cos(a) + 0.14128 * cos(2 * a) - 0.01168 * cos(3 * a);
+
+    x[i] = (dac - dacMax / 2.0) * w;
+    acc = (acc + reg) & (AD_2POW28 - 1);
+  }
+
+  fft(x);
+  for (size_t i = 0; i < n / 2; i++)
+    p[i] = std::norm(x[i]);
+
+  // Fundamental is the largest bin near the expected position
+  size_t expect = (size_t)(((uint64_t)reg * n) >> 28);
+  size_t fund = expect;
+
+  for (size_t i = (expect > guard ? expect - guard : 0); i <= expect + guard && i < n / 2; i++)
+    if (p[i] > p[fund]) fund = i;
+
+  // Largest bin outside the DC and fundamental main lobes is the worst spur
+  double spur = 1e-30;
+
+  for (size_t i = guard; i < n / 2; i++)
+  {
+    if (i + guard >= fund && i <= fund + guard) continue;
+    spur = std::max(spur, p[i]);
+  }
+
+  return(10.0 * log10(p[fund] / spur));
+}
+
+uint64_t sfdrKey(uint8_t fftBits, uint32_t reg)
+// SFDR results depend on the FFT size as well as the register value
+{
+  return(((uint64_t)fftBits << 32) | reg);
+}
+
+class Cache
+// SFDR results are saved by FFT size and register value, one per line.
+{
+public:
+  Cache(const std::string &name) : _name(name) {}
+
+  void load(void)
+  {
+    FILE* f = fopen(_name.c_str(), "r");
+    unsigned bits;
+    unsigned long reg;
+    double sfdr;
+
+    if (f == nullptr) return;
+    while (fscanf(f, "%u %lx %lf", &bits, &reg, &sfdr) == 3)
+      _data[sfdrKey((uint8_t)bits, (uint32_t)reg)] = sfdr;
+    fclose(f);
+  }
+
+  bool find(uint64_t key, double &sfdr)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _data.find(key);
+
+    if (it == _data.end()) return(false);
+    sfdr = it->second;
+    return(true);
+  }
+
+  void add(uint64_t key, double sfdr)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _data[key] = sfdr;
+    _new[key] = sfdr;
+  }
+
+  void save(void)
+  {
+    FILE* f;
+
+    if (_new.empty()) return;
+    if ((f = fopen(_name.c_str(), "a")) == nullptr)
+    {
+      fprintf(stderr, "Cannot write cache file %s\n", _name.c_str());
+      return;
+    }
+    for (auto &e : _new)
+      fprintf(f, "%u %07lx %.2f\n", (unsigned)(e.first >> 32), (unsigned long)(e.first & 0xffffffff), e.second);
+    fclose(f);
+  }
+
+private:
+  std::string _name;
+  std::map<uint64_t, double> _data;
+  std::map<uint64_t, double> _new;
+  std::mutex _mutex;
+};
+
+void analyze(const config_t &cfg, Cache &cache, std::vector<target_t> &targets)
+// Work out the SFDR for every candidate register value using a pool
+// of worker threads, then pick the best candidate for each target.
+{
+  std::set<uint64_t> needed;
+  std::vector<uint64_t> work;
+  std::map<uint64_t, double> sfdr;
+  std::atomic<size_t> next(0);
+  std::mutex resultMutex;
+  unsigned jobs = cfg.jobs ? cfg.jobs : std::max(1u, std::thread::hardware_concurrency());
+
+  // list of all the unique candidates, less those already cached
+  for (auto &t : targets)
+  {
+    uint32_t lo = t.reg > cfg.width ? t.reg - cfg.width : 1;
+    uint32_t hi = std::min(t.reg + cfg.width, AD_2POW28 - 1);
+
+    for (uint32_t r = lo; r <= hi; r++)
+    {
+      uint64_t key = sfdrKey(t.fftBits, r);
+      double s;
+
+      if (cache.find(key, s)) sfdr[key] = s;
+      else needed.insert(key);
+    }
+  }
+  work.assign(needed.begin(), needed.end());   // largest FFT size last
+
+  // each thread keeps a buffer for the largest FFT size, so limit the 
+  // number of threads to keep the buffers within the memory limit
+  if (!work.empty())
+  {
+    size_t mem = fftMemory((uint8_t)(work.back() >> 32));
+    unsigned maxJobs = (unsigned)std::max((size_t)1, (cfg.memLimit << 20) / mem);
+
+    if (jobs > maxJobs)
+    {
+      fprintf(stderr, "Using %u threads to keep %zu MiB FFT buffers within %zu MiB\n", maxJobs, mem >> 20, cfg.memLimit);
+      jobs = maxJobs;
+    }
+  }
+  fprintf(stderr, "%zu candidates to analyze, %zu cached, %u threads\n", work.size(), sfdr.size(), jobs);
+
+  std::vector<std::thread> pool;
+  for (unsigned j = 0; j < jobs; j++)
+    pool.emplace_back([&]()
+    {
+      fftBuffer_t buf;
+      size_t i;
+
+      while ((i = next++) < work.size())
+      {
+        double s = calcSFDR((uint32_t)work[i], (uint8_t)(work[i] >> 32), buf);
+
+        cache.add(work[i], s);
+        std::lock_guard<std::mutex> lock(resultMutex);
+        sfdr[work[i]] = s;
+      }
+    });
+  for (auto &t : pool)
+    t.join();
+
+  // best candidate within the allowed frequency error, nearest on a tie
+  double step = (double)cfg.mClk / AD_2POW28;
+
+  for (auto &t : targets)
+  {
+    uint32_t lo = t.reg > cfg.width ? t.reg - cfg.width : 1;
+    uint32_t hi = std::min(t.reg + cfg.width, AD_2POW28 - 1);
+
+    t.sfdrReg = t.sfdrBest = sfdr[sfdrKey(t.fftBits, t.reg)];
+    t.best = t.reg;
+    for (uint32_t r = lo; r <= hi; r++)
+    {
+      double s = sfdr[sfdrKey(t.fftBits, r)];
+
+      if (fabs(r * step - t.freq) > cfg.maxError) continue;
+      if (s > t.sfdrBest ||
+         (s == t.sfdrBest && labs((long)r - (long)t.reg) < labs((long)t.best - (long)t.reg)))
+      {
+        t.best = r;
+        t.sfdrBest = s;
+      }
+    }
+    if (t.sfdrBest - t.sfdrReg < cfg.minGain)
+    {
+      t.best = t.reg;
+      t.sfdrBest = t.sfdrReg;
+    }
+  }
+}
+
+bool writeTable(const config_t &cfg, const std::vector<target_t> &targets)
+// Write the table entries, sorted and unique by the calculated register
+// value as required by MD_AD9833::setTuningTable(). A target gets a 
+// second entry when the millihertz register value is different.
+{
+  FILE* f = fopen(cfg.outFile.c_str(), "w");
+  double step = (double)cfg.mClk / AD_2POW28;
+  std::map<uint32_t, const target_t*> entries;
+  size_t count = 0;
+
+  if (f == nullptr)
+  {
+    fprintf(stderr, "Cannot write output file %s\n", cfg.outFile.c_str());
+    return(false);
+  }
+
+  for (auto &t : targets)
+  {
+    if (t.best == t.reg) continue;
+    entries.insert({ t.reg, &t });        // first target for a key is used
+    if (t.regmHz != t.best) entries.insert({ t.regmHz, &t });
+  }
+
+  fprintf(f, "// MD_AD9833 tuning table created by AD9833_SpurTable\n");
+  fprintf(f, "// Reference clock %lu Hz, FFT size 2^%u or more, +/-%lu register values checked\n",
+    (unsigned long)cfg.mClk, cfg.fftBits, (unsigned long)cfg.width);
+  fprintf(f, "// Use with AD.setTuningTable(tuneTable, TUNE_TABLE_SIZE);\n");
+  fprintf(f, "#pragma once\n\n");
+  fprintf(f, "const MD_AD9833::tuneEntry_t tuneTable[] PROGMEM =\n{\n");
+  for (auto &e : entries)
+  {
+    const target_t &t = *e.second;
+
+    fprintf(f, "  { 0x%07lx, 0x%07lx },  // %.3f Hz: %.1f dB -> %.1f dB, error %+.3f Hz\n",
+      (unsigned long)e.first, (unsigned long)t.best, t.freq, t.sfdrReg, t.sfdrBest, t.best * step - t.freq);
+    count++;
+  }
+  if (count == 0)
+    fprintf(f, "  { 0, 0 }   // no improvements found\n");
+  fprintf(f, "};\n\n");
+  fprintf(f, "const uint16_t TUNE_TABLE_SIZE = %zu;\n", count);
+  fclose(f);
+
+  fprintf(stderr, "%zu table entries written to %s\n", count, cfg.outFile.c_str());
+  return(true);
+}
+
+void usage(void)
+{
+  fprintf(stderr, "usage: AD9833_SpurTable [-c clk] [-n bits] [-w words] [-e hz] [-g db] [-j jobs] [-m mib]\n");
+  fprintf(stderr, "                        [-f file] [-k cache] [-o output] freq [freq ...]\n");
+  exit(1);
+}
+
+bool readTargets(const char* name, std::vector<double> &targets)
+{
+  FILE* f = fopen(name, "r");
+  double freq;
+
+  if (f == nullptr) return(false);
+  while (fscanf(f, "%lf", &freq) == 1)
+    targets.push_back(freq);
+  fclose(f);
+
+  return(true);
+}
+
+int main(int argc, char* argv[])
+{
+  config_t cfg;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0')
+    {
+      if (i + 1 >= argc) usage();
+      const char* v = argv[++i];
+
+      switch (argv[i - 1][1])
+      {
+      case 'c': cfg.mClk = strtoul(v, nullptr, 10);          break;
+      case 'n': cfg.fftBits = (uint8_t)atoi(v);              break;
+      case 'w': cfg.width = strtoul(v, nullptr, 10);         break;
+      case 'e': cfg.maxError = atof(v);                      break;
+      case 'g': cfg.minGain = atof(v);                       break;
+      case 'j': cfg.jobs = (unsigned)atoi(v);                break;
+      case 'm': cfg.memLimit = strtoul(v, nullptr, 10);      break;
+      case 'k': cfg.cacheFile = v;                           break;
+      case 'o': cfg.outFile = v;                             break;
+      case 'f':
+        if (!readTargets(v, cfg.targets))
+        {
+          fprintf(stderr, "Cannot read target file %s\n", v);
+          return(1);
+        }
+        break;
+      default: usage();
+      }
+    }
+    else
+      cfg.targets.push_back(atof(argv[i]));
+  }
+
+  if (cfg.targets.empty() || cfg.mClk == 0 || cfg.fftBits < 8 || cfg.fftBits > FFT_MAX_BITS)
+    usage();
+
+  std::vector<target_t> targets;
+  for (double f : cfg.targets)
+  {
+    if (f <= 0 || f >= cfg.mClk / 2.0)
+    {
+      fprintf(stderr, "Ignoring %.3f Hz, outside 0 to MCLK/2\n", f);
+      continue;
+    }
+
+    uint32_t reg = calcFreq(f, cfg.mClk);
+    uint8_t bits = fftSize(reg, cfg.fftBits);
+
+    if (bits == 0)
+    {
+      fprintf(stderr, "Ignoring %.3f Hz, too low for an FFT size of 2^%u\n", f, FFT_MAX_BITS);
+      continue;
+    }
+    if (bits != cfg.fftBits)
+      fprintf(stderr, "Using FFT size 2^%u for %.3f Hz\n", bits, f);
+    targets.push_back({ f, reg, calcFreqmHz(f, cfg.mClk), bits, 0, 0.0, 0.0 });
+  }
+
+  Cache cache(cfg.cacheFile);
+
+  cache.load();
+  analyze(cfg, cache, targets);
+  cache.save();
+
+  for (auto &t : targets)
+    printf("%14.3f Hz  2^%-2u  reg 0x%07lx %6.1f dB  best 0x%07lx %6.1f dB\n",
+      t.freq, t.fftBits, (unsigned long)t.reg, t.sfdrReg, (unsigned long)t.best, t.sfdrBest);
+
+  return(writeTable(cfg, targets) ? 0 : 1);
+}
@@ -4,6 +4,7 @@ MD_AD9833 - Library for controlling an AD9833 Programmable Waveform Generator.
 See the main header file for full information
 */
 #include <SPI.h>
+#include <string.h>
 #include "MD_AD9833.h"
 #include "MD_AD9833_lib.h"
 
@@ -81,13 +82,329 @@ void MD_AD9833::spiSend(uint16_t data)
   }
 }
 
+void MD_AD9833::spiSend(const uint16_t* buf, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; i++)
+    spiSend(buf[i]);
+}
+
+// Register encoding functions
+uint8_t MD_AD9833::encodeFrequency(uint16_t* buf, uint16_t &ctl, channel_t chan, uint32_t reg)
+{
+  uint16_t  freq_select = SEL_FREQ0;   // stop ESP32 compiler warnings
+
+  // select the address mask
+  switch (chan)
+  {
+  case CHAN_0:  freq_select = SEL_FREQ0; break;
+  case CHAN_1:  freq_select = SEL_FREQ1; break;
+  }
+
+  // B28 is set by default for the library, but send it again here
+  // so that the two parts of the frequency can be sent 14 bits at 
+  // a time, LSBs first
+  bitSet(ctl, AD_B28);
+  buf[0] = ctl;
+  buf[1] = freq_select | (uint16_t)(reg & 0x3fff);
+  buf[2] = freq_select | (uint16_t)((reg >> 14) & 0x3fff);
+
+  return(3);
+}
+
+uint8_t MD_AD9833::encodePhase(uint16_t* buf, channel_t chan, uint16_t reg)
+{
+  uint16_t  phase_select = SEL_PHASE0;     // stop ESP32 compiler warnings
+
+  // select the address mask
+  switch (chan)
+  {
+  case CHAN_0:  phase_select = SEL_PHASE0; break;
+  case CHAN_1:  phase_select = SEL_PHASE1; break;
+  }
+
+  // the phase is 12 bits with appropriate address bits
+  buf[0] = phase_select | (0xfff & reg);
+
+  return(1);
+}
+
+uint8_t MD_AD9833::encodeFrequencyChange(uint16_t* buf, uint16_t &ctl, channel_t chan, uint32_t regOld, uint32_t regNew)
+// With B28 = 0 the two 14-bit halves are written separately, selected
+// by HLB. When both halves change B28 = 1 writes LSB then MSB.
+{
+  uint16_t  freq_select = SEL_FREQ0;   // stop ESP32 compiler warnings
+  uint16_t  lsb = (uint16_t)(regNew & 0x3fff);
+  uint16_t  msb = (uint16_t)((regNew >> 14) & 0x3fff);
+  bool      lsbChange = (lsb != (uint16_t)(regOld & 0x3fff));
+  bool      msbChange = (msb != (uint16_t)((regOld >> 14) & 0x3fff));
+  uint16_t  newCtl = ctl;
+  uint8_t   count = 0;
+
+  // select the address mask
+  switch (chan)
+  {
+  case CHAN_0:  freq_select = SEL_FREQ0; break;
+  case CHAN_1:  freq_select = SEL_FREQ1; break;
+  }
+
+  if (lsbChange && msbChange)
+    bitSet(newCtl, AD_B28);
+  else if (lsbChange || msbChange)
+  {
+    bitClear(newCtl, AD_B28);
+    if (msbChange) bitSet(newCtl, AD_HLB); else bitClear(newCtl, AD_HLB);
+  }
+  else
+    return(0);
+
+  if (newCtl != ctl)
+  {
+    ctl = newCtl;
+    buf[count++] = ctl;
+  }
+  if (lsbChange) buf[count++] = freq_select | lsb;
+  if (msbChange) buf[count++] = freq_select | msb;
+
+  return(count);
+}
+
+uint8_t MD_AD9833::encodeMode(uint16_t* buf, uint16_t &ctl, mode_t mode)
+{
+  switch (mode)
+  {
+  case MODE_OFF:
+    bitClear(ctl, AD_OPBITEN);
+    bitClear(ctl, AD_MODE);
+    bitSet(ctl, AD_SLEEP1);
+    bitSet(ctl, AD_SLEEP12);
+    break;
+  case MODE_SINE:
+    bitClear(ctl, AD_OPBITEN);
+    bitClear(ctl, AD_MODE);
+    bitClear(ctl, AD_SLEEP1);
+    bitClear(ctl, AD_SLEEP12);
+    break;
+  case MODE_SQUARE1:
+    bitSet(ctl, AD_OPBITEN);
+    bitClear(ctl, AD_MODE);
+    bitSet(ctl, AD_DIV2);
+    bitClear(ctl, AD_SLEEP1);
+    bitClear(ctl, AD_SLEEP12);
+    break;
+  case MODE_SQUARE2:
+    bitSet(ctl, AD_OPBITEN);
+    bitClear(ctl, AD_MODE);
+    bitClear(ctl, AD_DIV2);
+    bitClear(ctl, AD_SLEEP1);
+    bitClear(ctl, AD_SLEEP12);
+    break;
+  case MODE_TRIANGLE:
+    bitClear(ctl, AD_OPBITEN);
+    bitSet(ctl, AD_MODE);
+    bitClear(ctl, AD_SLEEP1);
+    bitClear(ctl, AD_SLEEP12);
+    break;
+  }
+
+  buf[0] = ctl;
+
+  return(1);
+}
+
+uint8_t MD_AD9833::encodeActiveFrequency(uint16_t* buf, uint16_t &ctl, channel_t chan)
+{
+  switch (chan)
+  {
+  case CHAN_0: bitClear(ctl, AD_FSELECT); break;
+  case CHAN_1: bitSet(ctl, AD_FSELECT);   break;
+  }
+
+  buf[0] = ctl;
+
+  return(1);
+}
+
+uint8_t MD_AD9833::encodeActivePhase(uint16_t* buf, uint16_t &ctl, channel_t chan)
+{
+  switch (chan)
+  {
+  case CHAN_0: bitClear(ctl, AD_PSELECT); break;
+  case CHAN_1: bitSet(ctl, AD_PSELECT);   break;
+  }
+
+  buf[0] = ctl;
+
+  return(1);
+}
+
+uint8_t MD_AD9833::encodeReset(uint16_t* buf, uint16_t &ctl, bool hold)
+// Reset is done on a 1 to 0 transition
+{
+  uint8_t count = 0;
+
+  bitSet(ctl, AD_RESET);
+  buf[count++] = ctl;
+  if (!hold)
+  {
+    bitClear(ctl, AD_RESET);
+    buf[count++] = ctl;
+  }
+
+  return(count);
+}
+
+uint8_t MD_AD9833::encodeSleep(uint16_t* buf, uint16_t &ctl, sleep_t state)
+{
+  if (state & SLEEP_MCLK) bitSet(ctl, AD_SLEEP1);  else bitClear(ctl, AD_SLEEP1);
+  if (state & SLEEP_DAC)  bitSet(ctl, AD_SLEEP12); else bitClear(ctl, AD_SLEEP12);
+
+  buf[0] = ctl;
+
+  return(1);
+}
+
+uint32_t MD_AD9833::divRound(uint32_t q, uint32_t r, uint32_t d, uint8_t bits)
+// Continue the long division of a remainder r (r < d) by d for the 
+// specified number of quotient bits, appending them to q, and then
+// round the result to nearest using the final remainder.
+// When d is 2^31 or less 2r always fits into 32 bits, so each step 
+// is one shift, compare and subtract. Otherwise r is compared against 
+// (d - r), worked out once per step, to avoid the overflow.
+{
+  if (d <= 0x80000000UL)
+  {
+    for (uint8_t i = 0; i < bits; i++)
+    {
+      q <<= 1;
+      r <<= 1;
+      if (r >= d)
+      {
+        r -= d;
+        q |= 1;
+      }
+    }
+  }
+  else
+  {
+    for (uint8_t i = 0; i < bits; i++)
+    {
+      uint32_t t = d - r;
+
+      q <<= 1;
+      if (r >= t)
+      {
+        r -= t;
+        q |= 1;
+      }
+      else
+        r <<= 1;
+    }
+  }
+
+  if (r >= d - r) q++;    // round half up
+
+  return(q);
+}
+
+uint32_t MD_AD9833::calcFreq(float f, uint32_t mClk)
+// Calculate register value for AD9833 frequency register 
+// from the specified frequency.
+// The float is exactly m * 2^s, with m a 24 bit integer, so the 
+// register value m * 2^(s+28) / mClk is worked out by integer long
+// division of m by mClk for (s+28) quotient bits and then rounded. This
+// is correctly rounded for every float value and needs no float 
+// operations. Lower frequencies have a smaller exponent and take fewer
+// steps. The float calculation is only used for the values this method
+// cannot handle (reference clocks below 2^23 Hz).
+{ 
+  uint32_t bits;
+  uint32_t m, q = 0;
+  int16_t k;
+
+  memcpy(&bits, &f, sizeof(bits));
+  m = (bits & 0x7fffffUL) | 0x800000UL;
+  k = (int16_t)((bits >> 23) & 0xff) - 150 + 28;   // s + 28
+
+  if (f <= 0 || f >= mClk || k <= 0 || mClk < 0x800000UL)
+  {
+    if (f <= 0) return(0);
+    return (uint32_t)((f * AD_2POW28/mClk) + 0.5);
+  }
+
+  // mClk >= 2^23 and m < 2^24, so the first quotient bit is 0 or 1
+  if (m >= mClk)
+  {
+    m -= mClk;
+    q = 1;
+  }
+
+  q = divRound(q, m, mClk, k);
+  if (q >= AD_2POW28) q = AD_2POW28 - 1;  // rounded up to the clock frequency
+
+  return(q);
+}
+
+uint32_t MD_AD9833::calcFreqmHz(uint64_t mHz, uint32_t mClk)
+// Calculate register value for AD9833 frequency register 
+// from the specified frequency in millihertz.
+// reg = mHz * 2^28 / (1000 * mClk) = mHz * 2^25 / (125 * mClk)
+// The top 3 quotient bits are worked out in 64 bits as mHz may 
+// exceed 32 bits, then the remaining 25 bits in 32 bits.
+{
+  if (mClk > 0xffffffffUL / 125)
+    return(calcFreq(mHz / 1000.0, mClk));
+
+  uint32_t d = 125 * mClk;
+  uint64_t dd = (uint64_t)d << 2;
+  uint32_t q = 0;
+
+  if (mHz >= (uint64_t)d << 3) return(AD_2POW28 - 1);  // out of range
+
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    q <<= 1;
+    if (mHz >= dd)
+    {
+      mHz -= dd;
+      q |= 1;
+    }
+    dd >>= 1;
+  }
+
+  q = divRound(q, (uint32_t)mHz, d, 25);
+  if (q >= AD_2POW28) q = AD_2POW28 - 1;  // rounded up to the clock frequency
+
+  return(q);
+}
+
+uint64_t MD_AD9833::calcActualmHz(uint32_t reg, uint32_t mClk)
+// Calculate the output frequency in millihertz for a
+// frequency register value. 
+// f = reg * mClk * 1000 / 2^28 = reg * mClk * 125 / 2^25
+{
+  uint64_t f = (uint64_t)(reg & (AD_2POW28 - 1)) * mClk * 125;
+
+  return((f + (1UL << 24)) >> 25);
+}
+
+uint16_t MD_AD9833::calcPhase(float a) 
+// Calculate the value for AD9833 phase register from given 
+// phase in tenths of a degree
+{
+  return (uint16_t)((512.0 * (a/10) / 45) + 0.5);
+}
+
 // Class functions
 MD_AD9833::MD_AD9833(uint8_t fsyncPin) :
+_tuneTable(nullptr), _tuneSize(0),
+_chirpSteps(0), _chirpCount(0), _chirpStart(0), _chirpLast(0), _chirpError(0),
 _dataPin(0), _clkPin(0), _fsyncPin(fsyncPin), _hardwareSPI(true)
 {
 }
 
 MD_AD9833::MD_AD9833(uint8_t dataPin, uint8_t clkPin, uint8_t fsyncPin) :
+_tuneTable(nullptr), _tuneSize(0),
+_chirpSteps(0), _chirpCount(0), _chirpStart(0), _chirpLast(0), _chirpError(0),
 _dataPin(dataPin), _clkPin(clkPin), _fsyncPin(fsyncPin), _hardwareSPI(false)
 {
 }
@@ -99,15 +416,10 @@ MD_AD9833::~MD_AD9833(void)
 };
 
 void MD_AD9833::reset(bool hold)
-// Reset is done on a 1 to 0 transition
 {
-  bitSet(_regCtl, AD_RESET);
-  spiSend(_regCtl);
-  if (!hold)
-  {
-    bitClear(_regCtl, AD_RESET);
-    spiSend(_regCtl);
-  }
+  uint16_t buf[ENC_MAX_WORDS];
+
+  spiSend(buf, encodeReset(buf, _regCtl, hold));
 }
 
 void MD_AD9833::begin(void)
@@ -145,6 +457,7 @@ void MD_AD9833::begin(void)
   setPhase(CHAN_1, AD_DEFAULT_PHASE);
   reset();                  // full transition
 
+  resetSleepStats();
   setMode(MODE_SINE);
   setActiveFrequency(CHAN_0);
   setActivePhase(CHAN_0);
@@ -152,15 +465,11 @@ void MD_AD9833::begin(void)
 
 boolean MD_AD9833::setActiveFrequency(channel_t chan)
 {
-  PRINT("\nsetActiveFreq CHAN_", chan);
+  uint16_t buf[ENC_MAX_WORDS];
 
-  switch (chan)
-  {
-  case CHAN_0: bitClear(_regCtl, AD_FSELECT); break;
-  case CHAN_1: bitSet(_regCtl, AD_FSELECT);   break;
-  }
+  PRINT("\nsetActiveFreq CHAN_", chan);
 
-  spiSend(_regCtl);
+  spiSend(buf, encodeActiveFrequency(buf, _regCtl, chan));
 
   return(true);
 }
@@ -172,15 +481,11 @@ MD_AD9833::channel_t MD_AD9833::getActiveFrequency(void)
 
 boolean MD_AD9833::setActivePhase(channel_t chan)
 {
-  PRINT("\nsetActivePhase CHAN_", chan);
+  uint16_t buf[ENC_MAX_WORDS];
 
-  switch (chan)
-  {
-  case CHAN_0: bitClear(_regCtl, AD_PSELECT); break;
-  case CHAN_1: bitSet(_regCtl, AD_PSELECT);   break;
-  }
+  PRINT("\nsetActivePhase CHAN_", chan);
 
-  spiSend(_regCtl);
+  spiSend(buf, encodeActivePhase(buf, _regCtl, chan));
 
   return(true);
 }
@@ -192,104 +497,476 @@ MD_AD9833::channel_t MD_AD9833::getActivePhase(void)
 
 boolean MD_AD9833::setMode(mode_t mode)
 {
+  uint16_t buf[ENC_MAX_WORDS];
+
   PRINTS("\nsetWave ");
+  switch (mode)
+  {
+  case MODE_OFF:      PRINTS("OFF");  break;
+  case MODE_SINE:     PRINTS("SINE"); break;
+  case MODE_SQUARE1:  PRINTS("SQ1");  break;
+  case MODE_SQUARE2:  PRINTS("SQ2");  break;
+  case MODE_TRIANGLE: PRINTS("TRNG"); break;
+  }
   _modeLast = mode;
 
-  switch (mode)
+  sleepTrack();
+  spiSend(buf, encodeMode(buf, _regCtl, mode));
+
+  return(true);
+}
+
+MD_AD9833::sleep_t MD_AD9833::getSleep(void)
+{
+  return((sleep_t)((bitRead(_regCtl, AD_SLEEP1) ? SLEEP_MCLK : SLEEP_NONE) | 
+                   (bitRead(_regCtl, AD_SLEEP12) ? SLEEP_DAC : SLEEP_NONE)));
+}
+
+boolean MD_AD9833::setSleep(sleep_t state)
+// Only the SLEEP bits are changed, so the control register image 
+// is always ready to restore the output with one write. MODE_OFF 
+// clears the waveform bits as well, so there is nothing to restore.
+{
+  uint16_t buf[ENC_MAX_WORDS];
+  bool wake = (state == SLEEP_NONE && getSleep() != SLEEP_NONE);
+  uint32_t start = micros();
+
+  PRINT("\nsetSleep ", state);
+
+  if (_modeLast == MODE_OFF)
+    return(false);
+
+  sleepTrack();
+  spiSend(buf, encodeSleep(buf, _regCtl, state));
+
+  if (wake)
   {
-  case MODE_OFF:
-    PRINTS("OFF");
-    bitClear(_regCtl, AD_OPBITEN);
-    bitClear(_regCtl, AD_MODE);
-    bitSet(_regCtl, AD_SLEEP1);
-    bitSet(_regCtl, AD_SLEEP12);
-    break;
-  case MODE_SINE:
-    PRINTS("SINE");
-    bitClear(_regCtl, AD_OPBITEN);
-    bitClear(_regCtl, AD_MODE);
-    bitClear(_regCtl, AD_SLEEP1);
-    bitClear(_regCtl, AD_SLEEP12);
-    break;
-  case MODE_SQUARE1:
-    PRINTS("SQ1");
-    bitSet(_regCtl, AD_OPBITEN);
-    bitClear(_regCtl, AD_MODE);
-    bitSet(_regCtl, AD_DIV2);
-    bitClear(_regCtl, AD_SLEEP1);
-    bitClear(_regCtl, AD_SLEEP12);
-    break;
-  case MODE_SQUARE2:
-    PRINTS("SQ2");
-    bitSet(_regCtl, AD_OPBITEN);
-    bitClear(_regCtl, AD_MODE);
-    bitClear(_regCtl, AD_DIV2);
-    bitClear(_regCtl, AD_SLEEP1);
-    bitClear(_regCtl, AD_SLEEP12);
+    _wakeLatency = micros() - start;
+    _wakeCount++;
+  }
+
+  return(true);
+}
+
+void MD_AD9833::sleepTrack(void)
+{
+  uint32_t now = millis();
+
+  _sleepTime[getSleep()] += now - _sleepStart;
+  _sleepStart = now;
+}
+
+uint32_t MD_AD9833::getSleepTime(sleep_t state)
+{
+  uint32_t t = _sleepTime[state];
+
+  if (state == getSleep())
+    t += millis() - _sleepStart;
+
+  return(t);
+}
+
+void MD_AD9833::resetSleepStats(void)
+{
+  for (uint8_t i = 0; i < 4; i++)
+    _sleepTime[i] = 0;
+  _sleepStart = millis();
+  _wakeLatency = _wakeCount = 0;
+}
+
+boolean MD_AD9833::chirpBegin(float fStart, float fEnd, uint32_t steps, uint32_t period, chirp_t type)
+{
+  uint16_t buf[ENC_MAX_WORDS];
+  channel_t chan = (getActiveFrequency() == CHAN_0) ? CHAN_1 : CHAN_0;
+  uint32_t regStart = calcFreq(fStart, _mClk);
+
+  PRINT("\nchirpBegin ", type);
+
+  // above half the reference clock the output would be an alias
+  if (steps == 0 || fStart < 0 || fEnd < 0 || 
+      fStart >= _mClk / 2.0 || fEnd >= _mClk / 2.0)
+    return(false);
+
+  _chirpType = type;
+  _chirpEnd = calcFreq(fEnd, _mClk);
+  _chirpAcc = (int64_t)regStart << 32;
+  _chirpInc = 0;
+  _chirpRatio = 0;
+
+  switch (type)
+  {
+  case CHIRP_LINEAR:
+    _chirpInc = ((int64_t)_chirpEnd - (int64_t)regStart) * 4294967296LL / (int64_t)steps;
     break;
-  case MODE_TRIANGLE:
-    PRINTS("TRNG");
-    bitClear(_regCtl, AD_OPBITEN);
-    bitSet(_regCtl, AD_MODE);
-    bitClear(_regCtl, AD_SLEEP1);
-    bitClear(_regCtl, AD_SLEEP12);
+
+  case CHIRP_GEOMETRIC:
+    {
+      // ratio - 1 = e^x - 1 with x = ln(end/start)/steps, worked out in
+      // 56 bit fixed point as the error in the ratio is multiplied by the
+      // number of steps. The register values are used as the start value
+      // is rounded.
+      if (regStart == 0 || _chirpEnd == 0) return(false);
+
+      int64_t x = (lnQ56(_chirpEnd) - lnQ56(regStart)) / (int64_t)steps;
+      int64_t t = x;
+
+      if (x <= -AD_Q56_LN2 || x >= AD_Q56_LN1_5) return(false); // ratio outside (0.5, 1.5)
+
+      for (uint8_t k = 2; t != 0; k++)
+      {
+        _chirpRatio += t;
+        t = mulQ56(t, x) / k;
+      }
+    }
     break;
   }
 
-  spiSend(_regCtl);
+  // Load the start frequency into the inactive register and switch to it,
+  // leaving B28 and HLB clear ready for the LSB only writes
+  _regFreq[chan] = regStart;
+  spiSend(buf, encodeFrequency(buf, _regCtl, chan, regStart));
+  bitClear(_regCtl, AD_B28);
+  bitClear(_regCtl, AD_HLB);
+  spiSend(buf, encodeActiveFrequency(buf, _regCtl, chan));
+
+  _chirpSteps = steps;
+  _chirpCount = 0;
+  _chirpPeriod = period;
+  _chirpError = 0;
+  _chirpStart = _chirpLast = micros();
 
   return(true);
 }
 
-uint32_t MD_AD9833::calcFreq(float f) 
-// Calculate register value for AD9833 frequency register 
-// from the specified frequency
-{ 
-  return (uint32_t)((f * AD_2POW28/_mClk) + 0.5);
+boolean MD_AD9833::chirpStep(void)
+{
+  uint16_t buf[ENC_MAX_WORDS + 1];
+  channel_t chan;
+  uint32_t reg;
+  uint8_t count;
+
+  if (_chirpCount >= _chirpSteps)
+    return(false);
+
+  // timing against the profile
+  _chirpLast = micros();
+  {
+    int32_t err = (int32_t)(_chirpLast - (_chirpStart + (_chirpCount + 1) * _chirpPeriod));
+
+    if (err < 0) err = -err;
+    if ((uint32_t)err > _chirpError) _chirpError = err;
+  }
+
+  // next frequency register value
+  if (++_chirpCount == _chirpSteps)
+    _chirpAcc = (int64_t)_chirpEnd << 32;   // land exactly on the end frequency
+  else if (_chirpType == CHIRP_LINEAR)
+    _chirpAcc += _chirpInc;
+  else    // acc * ratio from 32 bit products, rounded as any bias grows with acc
+  {
+    int32_t aH = (int32_t)(_chirpAcc >> 32);
+    int32_t aL = (int32_t)((uint32_t)_chirpAcc >> 8);
+    int32_t rH = (int32_t)(_chirpRatio >> 24);
+    int32_t rL = (int32_t)(_chirpRatio & 0xffffff);
+    int64_t mid = (int64_t)aH * rL + (int64_t)aL * rH + (((int64_t)aL * rL) >> 24);
+
+    _chirpAcc += (int64_t)aH * rH + ((mid + (1L << 23)) >> 24);
+  }
+  reg = (uint32_t)(_chirpAcc >> 32) & (AD_2POW28 - 1);
+
+  // write the inactive register and switch over to it
+  chan = bitRead(_regCtl, AD_FSELECT) ? CHAN_0 : CHAN_1;
+  count = encodeFrequencyChange(buf, _regCtl, chan, _regFreq[chan], reg);
+  _regFreq[chan] = reg;
+  bitClear(_regCtl, AD_B28);
+  bitClear(_regCtl, AD_HLB);
+  count += encodeActiveFrequency(buf + count, _regCtl, chan);
+  spiSend(buf, count);
+
+  return(true);
 }
 
-uint16_t MD_AD9833::calcPhase(float a) 
-// Calculate the value for AD9833 phase register from given 
-// phase in tenths of a degree
+void MD_AD9833::chirpEnd(void)
 {
-  return (uint16_t)((512.0 * (a/10) / 45) + 0.5);
+  PRINTS("\nchirpEnd");
+
+  _chirpSteps = _chirpCount;
+  for (uint8_t i = CHAN_0; i <= CHAN_1; i++)
+    _freq[i] = calcActualmHz(_regFreq[i], _mClk) / 1000.0;
+
+  bitSet(_regCtl, AD_B28);    // library default
+  bitClear(_regCtl, AD_HLB);
+  spiSend(_regCtl);
+}
+
+float MD_AD9833::getChirpRate(void)
+{
+  uint32_t t = _chirpLast - _chirpStart;
+
+  return(t == 0 ? 0.0 : (_chirpCount * 1000000.0) / t);
+}
+
+int64_t MD_AD9833::mulQ56(int64_t a, int64_t b)
+// Multiply 56 bit fixed point values less than 32 in size, with a
+// product less than 32, using 32 bit products as (a * b) does not 
+// fit into 64 bits.
+{
+  bool neg = (a < 0) != (b < 0);
+  uint64_t ua = (a < 0) ? -a : a;
+  uint64_t ub = (b < 0) ? -b : b;
+  uint32_t aH = ua >> 32, aL = (uint32_t)ua;
+  uint32_t bH = ub >> 32, bL = (uint32_t)ub;
+  uint64_t r;
+
+  r = ((uint64_t)aH * bH << 8) + 
+      (((uint64_t)aH * bL + (uint64_t)aL * bH + (((uint64_t)aL * bL) >> 32)) >> 24);
+
+  return(neg ? -(int64_t)r : (int64_t)r);
+}
+
+int64_t MD_AD9833::lnQ56(uint32_t n)
+// Natural log of n > 0 in 56 bit fixed point. n = 2^e * m with m 
+// between 1/sqrt(2) and sqrt(2), then ln(m) = 2 atanh(z) with 
+// z = (m - 1)/(m + 1), from the series z + z^3/3 + z^5/5 ...
+{
+  int8_t e = 0;
+  bool neg;
+  uint64_t m, d;
+  int64_t z, z2, t, sum = 0;
+
+  while ((n >> e) > 1) e++;
+  m = (uint64_t)n << (56 - e);
+  if (m > (uint64_t)AD_Q56_SQRT2)
+  {
+    m >>= 1;
+    e++;
+  }
+
+  // z by long division, |z| < 0.18
+  d = m + AD_Q56_ONE;
+  neg = (m < (uint64_t)AD_Q56_ONE);
+  m = neg ? AD_Q56_ONE - m : m - AD_Q56_ONE;
+  z = 0;
+  for (uint8_t i = 0; i < 56; i++)
+  {
+    z <<= 1;
+    m <<= 1;
+    if (m >= d)
+    {
+      m -= d;
+      z |= 1;
+    }
+  }
+  if (neg) z = -z;
+
+  z2 = mulQ56(z, z);
+  t = z;
+  for (uint8_t k = 1; t != 0; k += 2)
+  {
+    sum += t / k;
+    t = mulQ56(t, z2);
+  }
+
+  return(e * AD_Q56_LN2 + 2 * sum);
+}
+
+uint32_t MD_AD9833::seqRead(const uint8_t* &p, uint8_t len, bool progmem)
+// Read len data bytes, least significant first, and advance p
+{
+  uint32_t v = 0;
+
+  for (uint8_t i = 0; i < len; i++, p++)
+    v |= (uint32_t)(progmem ? pgm_read_byte(p) : *p) << (8 * i);
+
+  return(v);
+}
+
+boolean MD_AD9833::runSequence(const uint8_t* prog, uint16_t len, bool progmem)
+// The program is checked as it runs, so a corrupt program stops at the
+// first invalid instruction and never reads past the end of the buffer.
+{
+  const uint8_t* end = prog + len;
+  uint16_t buf[ENC_MAX_WORDS];
+  const uint8_t* loopStart[AD_SEQ_LOOP_DEPTH];
+  uint16_t loopCount[AD_SEQ_LOOP_DEPTH];
+  uint8_t loopLevel = 0;
+  uint8_t changed = 0;    // bit mask of frequency (0, 1) and phase (2, 3) registers changed
+  boolean ok = true;
+  uint32_t deadline = micros();
+
+  PRINTS("\nrunSequence");
+
+  while (true)
+  {
+    if (prog >= end) { ok = false; break; }   // no SEQ_END
+
+    uint8_t op = seqRead(prog, 1, progmem);
+    uint8_t arg = op & 0xf;
+    channel_t chan = (channel_t)arg;
+    uint8_t count = 0;
+
+    switch (op & 0xf0)
+    {
+    case SEQ_END:
+      if (arg != 0) ok = false;
+      break;
+
+    case SEQ_FREQ:
+      if (arg > CHAN_1 || end - prog < 4) { ok = false; break; }
+      _regFreq[chan] = seqRead(prog, 4, progmem) & (AD_2POW28 - 1);
+      bitSet(changed, chan);
+      count = encodeFrequency(buf, _regCtl, chan, _regFreq[chan]);
+      break;
+
+    case SEQ_PHASE:
+      if (arg > CHAN_1 || end - prog < 2) { ok = false; break; }
+      _regPhase[chan] = seqRead(prog, 2, progmem) & 0xfff;
+      bitSet(changed, chan + 2);
+      count = encodePhase(buf, chan, _regPhase[chan]);
+      break;
+
+    case SEQ_SELFREQ:
+      if (arg > CHAN_1) { ok = false; break; }
+      count = encodeActiveFrequency(buf, _regCtl, chan);
+      break;
+
+    case SEQ_SELPHASE:
+      if (arg > CHAN_1) { ok = false; break; }
+      count = encodeActivePhase(buf, _regCtl, chan);
+      break;
+
+    case SEQ_MODE:
+      if (arg > MODE_TRIANGLE) { ok = false; break; }
+      _modeLast = (mode_t)arg;
+      sleepTrack();
+      count = encodeMode(buf, _regCtl, _modeLast);
+      break;
+
+    case SEQ_WAIT:
+      if (arg != 0 || end - prog < 4) { ok = false; break; }
+      // wait from the last deadline so instruction time does not accumulate
+      deadline += seqRead(prog, 4, progmem);
+      while ((int32_t)(micros() - deadline) < 0)
+        ;
+      break;
+
+    case SEQ_LOOP:
+      if (arg != 0 || loopLevel >= AD_SEQ_LOOP_DEPTH || end - prog < 2) { ok = false; break; }
+      loopCount[loopLevel] = seqRead(prog, 2, progmem);
+      loopStart[loopLevel++] = prog;
+      break;
+
+    case SEQ_NEXT:
+      if (arg != 0 || loopLevel == 0) { ok = false; break; }
+      if (loopCount[loopLevel - 1] == 0 || --loopCount[loopLevel - 1] != 0)
+        prog = loopStart[loopLevel - 1];    // 0 is forever
+      else
+        loopLevel--;
+      break;
+
+    case SEQ_RESET:
+      if (arg > 1) { ok = false; break; }
+      count = encodeReset(buf, _regCtl, arg != 0);
+      break;
+
+    case SEQ_SLEEP:
+      if (arg > SLEEP_ALL || _modeLast == MODE_OFF) { ok = false; break; }
+      sleepTrack();
+      count = encodeSleep(buf, _regCtl, (sleep_t)arg);
+      break;
+
+    default:
+      ok = false;
+      break;
+    }
+
+    if (!ok || (op & 0xf0) == SEQ_END) break;
+    spiSend(buf, count);
+  }
+
+  // bring the settings memory up to date with the registers
+  for (uint8_t i = CHAN_0; i <= CHAN_1; i++)
+  {
+    if (bitRead(changed, i)) _freq[i] = calcActualmHz(_regFreq[i], _mClk) / 1000.0;
+    if (bitRead(changed, i + 2)) _phase[i] = (uint16_t)(((uint32_t)_regPhase[i] * 3600 + 2048) >> 12);
+  }
+
+  PRINT(" - ", ok ? "ok" : "error");
+
+  return(ok);
+}
+
+uint32_t MD_AD9833::tuneFreq(uint32_t reg)
+// Binary search the sorted PROGMEM tuning table for the 
+// register value and return the replacement if found.
+{
+  uint16_t lo = 0, hi = _tuneSize;
+
+  while (lo < hi)
+  {
+    uint16_t mid = lo + ((hi - lo) >> 1);
+    uint32_t r = pgm_read_dword(&_tuneTable[mid].reg);
+
+    if (r == reg)
+    {
+      reg = pgm_read_dword(&_tuneTable[mid].best);
+      PRINTX(" tuned", reg);
+      break;
+    }
+    else if (r < reg)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return(reg);
 }
 
 boolean MD_AD9833::setFrequency(channel_t chan, float freq)
 {
-  uint16_t  freq_select = SEL_FREQ0;   // stop ESP32 compiler warnings
+  uint16_t buf[ENC_MAX_WORDS];
 
   PRINT("\nsetFreq CHAN_", chan);
 
   _freq[chan] = freq;
-
-  _regFreq[chan] = calcFreq(freq);
+  _regFreq[chan] = tuneFreq(calcFreq(freq, _mClk));
 
   PRINT(" - freq ", _freq[chan]);
   PRINTX(" =", _regFreq[chan]);
 
-  // select the address mask
-  switch (chan)
-  {
-  case CHAN_0:  freq_select = SEL_FREQ0; break;
-  case CHAN_1:  freq_select = SEL_FREQ1; break;
-  }
+  spiSend(buf, encodeFrequency(buf, _regCtl, chan, _regFreq[chan]));
+
+  return(true);
+}
 
-  // Assumes B28 is on so we can send consecutive words
-  // B28 is set by default for the library, so just send it here
-  // Now send the two parts of the frequency 14 bits at a time,
-  // LSBs first
+boolean MD_AD9833::setFrequencymHz(channel_t chan, uint64_t mHz)
+{
+  uint16_t buf[ENC_MAX_WORDS];
+
+  PRINT("\nsetFreqmHz CHAN_", chan);
+
+  if (mHz >= (uint64_t)_mClk * 1000)
+    return(false);
+
+  _freq[chan] = mHz / 1000.0;
+  _regFreq[chan] = tuneFreq(calcFreqmHz(mHz, _mClk));
+
+  PRINT(" - freq ", _freq[chan]);
+  PRINTX(" =", _regFreq[chan]);
 
-  spiSend(_regCtl);   // set B28
-  spiSend(freq_select | (uint16_t)(_regFreq[chan] & 0x3fff));
-  spiSend(freq_select | (uint16_t)((_regFreq[chan] >> 14) & 0x3fff));
+  spiSend(buf, encodeFrequency(buf, _regCtl, chan, _regFreq[chan]));
 
   return(true);
 }
 
+float MD_AD9833::getFrequencyStep(void)
+{
+  return((float)_mClk / AD_2POW28);
+}
+
 boolean MD_AD9833::setPhase(channel_t chan, uint16_t phase)
 {
-  uint16_t  phase_select = SEL_PHASE0;     // stop ESP32 compiler warnings
+  uint16_t buf[ENC_MAX_WORDS];
 
   PRINT("\nsetPhase CHAN_", chan);
 
@@ -299,17 +976,7 @@ boolean MD_AD9833::setPhase(channel_t chan, uint16_t phase)
   PRINT(" - phase ", _phase[chan]);
   PRINTX(" =", _regPhase[chan]);
 
-  // select the address mask
-  switch (chan)
-  {
-  case CHAN_0:  phase_select = SEL_PHASE0; break;
-  case CHAN_1:  phase_select = SEL_PHASE1; break;
-  }
-
-  // Now send the phase as 12 bits with appropriate address bits
-  spiSend(phase_select | (0xfff & _regPhase[chan]));
+  spiSend(buf, encodePhase(buf, chan, _regPhase[chan]));
   
   return(true);
-
 }
-
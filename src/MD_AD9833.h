@@ -29,6 +29,16 @@ Topics
 - \subpage pageDonation
 
 \page pageRevHistory Revision History
+Oct 2026 version 1.4.0
+- Added register encoding methods to build SPI words without accessing the hardware
+- Added millihertz frequency methods with correctly rounded register values
+- Added getActualFrequency() and getFrequencyStep() methods
+- Frequency register values from float frequencies are correctly rounded, see FreqBench example
+- Added setTuningTable() and the AD9833_SpurTable tool to avoid high spur frequency register values
+- Added setSleep() power states that keep the waveform settings, with power state statistics
+- Added frequency chirp methods and Chirp example
+- Added runSequence() bytecode sequencer, AD9833_SeqAsm tool and Sequencer example
+
 Jun 2024 version 1.3.0
 - Added get/setClk() methods for clock reference frequency
 
@@ -132,6 +142,68 @@ class MD_AD9833
     MODE_TRIANGLE,  ///< Set output to a triangle wave at selected frequency
   };
 
+ /**
+  * Tuning table entry type.
+  *
+  * Each entry in a tuning table replaces the frequency register value
+  * calculated for a frequency with an alternative value. Tables are 
+  * loaded using \ref setTuningTable().
+  */
+  typedef struct
+  {
+    uint32_t reg;   ///< frequency register value as calculated by the library
+    uint32_t best;  ///< replacement frequency register value
+  } tuneEntry_t;
+
+ /**
+  * Power state enumerated type.
+  *
+  * This enumerated type is used with the \ref setSleep() method to identify
+  * the power state. The values match the SLEEP1 and SLEEP12 control bits.
+  */
+  enum sleep_t
+  {
+    SLEEP_NONE = 0, ///< MCLK and DAC both powered, normal output
+    SLEEP_DAC = 1,  ///< DAC powered down, MCLK running
+    SLEEP_MCLK = 2, ///< MCLK stopped, DAC output holds its present value
+    SLEEP_ALL = 3,  ///< MCLK stopped and DAC powered down
+  };
+
+ /**
+  * Chirp profile enumerated type.
+  *
+  * This enumerated type is used with the \ref chirpBegin() method to 
+  * identify how the frequency changes at each step.
+  */
+  enum chirp_t
+  {
+    CHIRP_LINEAR,     ///< Frequency changes by a constant amount each step
+    CHIRP_GEOMETRIC,  ///< Frequency changes by a constant ratio each step
+  };
+
+ /**
+  * Sequencer instruction enumerated type.
+  *
+  * This enumerated type defines the instruction codes used in programs 
+  * run by \ref runSequence(). Each instruction is a code byte, with the 
+  * operand in the low nibble where shown (0 otherwise), followed by the 
+  * number of data bytes shown, least significant byte first.
+  */
+  enum seqOp_t
+  {
+    SEQ_END = 0x00,       ///< End of program
+    SEQ_FREQ = 0x10,      ///< Low nibble channel, 4 bytes 28-bit frequency register value
+    SEQ_PHASE = 0x20,     ///< Low nibble channel, 2 bytes 12-bit phase register value
+    SEQ_SELFREQ = 0x30,   ///< Low nibble channel to use as the output frequency
+    SEQ_SELPHASE = 0x40,  ///< Low nibble channel to use as the output phase
+    SEQ_MODE = 0x50,      ///< Low nibble mode_t output mode
+    SEQ_WAIT = 0x60,      ///< 4 bytes time in microseconds
+    SEQ_LOOP = 0x70,      ///< 2 bytes repeat count (0 is forever) up to the matching SEQ_NEXT
+    SEQ_NEXT = 0x80,      ///< End of the SEQ_LOOP instructions
+    SEQ_RESET = 0x90,     ///< Low nibble 1 to hold reset, 0 otherwise
+    SEQ_SLEEP = 0xa0,     ///< Low nibble sleep_t power state
+  };
+
  /**
   * Class Constructor - arbitrary digital interface.
   *
@@ -266,6 +338,81 @@ class MD_AD9833
   */
   boolean setFrequency(channel_t chan, float freq);
 
+  /**
+  * Set channel frequency in millihertz
+  *
+  * Set the specified AD9833 channel output frequency in thousandths of a Hz.
+  * 1000.5 Hz is passed as 1000500. The frequency register value is the 
+  * correctly rounded nearest value to the requested frequency.
+  *
+  * \sa getActualFrequencymHz(), calcFreqmHz()
+  *
+  * \param chan output channel identifier (channel_t)
+  * \param mHz  frequency in millihertz, less than the reference clock frequency
+  * \return true if successful, false otherwise
+  */
+  boolean setFrequencymHz(channel_t chan, uint64_t mHz);
+
+  /**
+  * Get actual channel frequency
+  *
+  * Get the frequency produced by the AD9833 for the specified channel. This 
+  * is derived from the frequency register value and the reference clock 
+  * and may differ slightly from the frequency requested.
+  *
+  * \sa getActualFrequencymHz(), getFrequency()
+  *
+  * \param chan output channel identifier (channel_t)
+  * \return the output frequency in Hz
+  */
+  inline float getActualFrequency(channel_t chan) { return(getActualFrequencymHz(chan) / 1000.0); }
+
+  /**
+  * Get actual channel frequency in millihertz
+  *
+  * Get the frequency produced by the AD9833 for the specified channel,
+  * rounded to the nearest millihertz.
+  *
+  * \sa getActualFrequency(), calcActualmHz()
+  *
+  * \param chan output channel identifier (channel_t)
+  * \return the output frequency in millihertz
+  */
+  inline uint64_t getActualFrequencymHz(channel_t chan) { return(calcActualmHz(_regFreq[chan], _mClk)); }
+
+  /**
+  * Get the frequency resolution
+  *
+  * Get the difference in frequency between adjacent frequency register 
+  * values for the current reference clock (MCLK/2^28). The exact 
+  * frequency for any register value is given by calcActualmHz().
+  *
+  * \return the frequency step in Hz
+  */
+  float getFrequencyStep(void);
+
+  /**
+  * Set the frequency tuning table
+  *
+  * Some frequency register values produce strong spurious output
+  * from the truncation of the phase accumulator in the AD9833. A tuning
+  * table lists alternative register values, close to the calculated 
+  * value, that give a cleaner output. Once set, the table is checked 
+  * every time a frequency is set and a matching entry's replacement 
+  * value is used instead of the calculated value.
+  *
+  * The table must be stored in PROGMEM, sorted in ascending order of the
+  * reg field, and is only valid for the reference clock frequency used 
+  * to create it. The AD9833_SpurTable tool in the library extras folder 
+  * creates suitable tables. Passing a nullptr removes the table.
+  *
+  * \sa setFrequency(), setFrequencymHz()
+  *
+  * \param table  pointer to the table in PROGMEM
+  * \param size   number of entries in the table
+  */
+  void setTuningTable(const tuneEntry_t* table, uint16_t size) { _tuneTable = table; _tuneSize = (table == nullptr ? 0 : size); }
+
   /**
   * Get AD9833 reference clock frequency
   *
@@ -349,6 +496,406 @@ class MD_AD9833
 
   /** @} */
 
+  //--------------------------------------------------------------
+  /** \name Methods for AD9833 power control
+   * @{
+   */
+  /**
+  * Get the power state
+  *
+  * Get the current AD9833 power state. This includes power down from
+  * setMode(MODE_OFF), which is the same as SLEEP_ALL.
+  *
+  * \sa setSleep()
+  *
+  * \return the current power state
+  */
+  sleep_t getSleep(void);
+
+  /**
+  * Set the power state
+  *
+  * Set the AD9833 power state with a single control register write. 
+  * Unlike setMode(MODE_OFF), the waveform, frequency and phase settings
+  * are left unchanged so that SLEEP_NONE restores the output as it was
+  * before the sleep. Setting a waveform using setMode() also wakes the 
+  * device.
+  *
+  * MODE_OFF does not keep the waveform setting, so the power state 
+  * cannot be changed while getMode() returns MODE_OFF and this method 
+  * returns false. Use setMode() to restart the output.
+  *
+  * \sa getSleep(), getSleepTime(), getWakeLatency()
+  *
+  * \param state  power state defined by one of the sleep_t enumerations
+  * \return true if successful, false if the mode is MODE_OFF
+  */
+  boolean setSleep(sleep_t state);
+
+  /**
+  * Get the time spent in a power state
+  *
+  * Get the total time the device has been in the specified power state
+  * since begin() or the last resetSleepStats(), including the current 
+  * period if it is the current state.
+  *
+  * \sa resetSleepStats()
+  *
+  * \param state  power state defined by one of the sleep_t enumerations
+  * \return the time in milliseconds
+  */
+  uint32_t getSleepTime(sleep_t state);
+
+  /**
+  * Get the wake up latency
+  *
+  * Get the time taken for the last wake up from a sleep state by 
+  * setSleep(SLEEP_NONE), up to the end of the control register write.
+  *
+  * \sa getWakeCount(), resetSleepStats()
+  *
+  * \return the last wake up time in microseconds
+  */
+  inline uint32_t getWakeLatency(void) { return _wakeLatency; }
+
+  /**
+  * Get the number of wake ups
+  *
+  * Get the number of wake ups from a sleep state by setSleep(SLEEP_NONE).
+  *
+  * \sa getWakeLatency(), resetSleepStats()
+  *
+  * \return the number of wake ups
+  */
+  inline uint32_t getWakeCount(void) { return _wakeCount; }
+
+  /**
+  * Reset the power state statistics
+  *
+  * Clear the power state times, wake up count and latency.
+  */
+  void resetSleepStats(void);
+
+  /** @} */
+
+  //--------------------------------------------------------------
+  /** \name Methods for AD9833 frequency chirps
+   *
+   * A chirp sweeps the output frequency from a start to an end frequency
+   * in a fixed number of steps, with chirpStep() called at a regular 
+   * interval, usually from a hardware timer interrupt service routine.
+   *
+   * The frequency register value is kept as a fixed point number so that
+   * each step is an addition (linear) or an integer multiply and addition 
+   * (geometric). Each new value is written into the inactive frequency 
+   * register, sending only the 14-bit halves that have changed, and the 
+   * output is then switched over to it. The output stays phase continuous 
+   * and never uses a partly written register.
+   *
+   * While a chirp is running the frequency registers and the active frequency
+   * channel belong to the chirp and the other frequency methods should 
+   * not be used.
+   * @{
+   */
+  /**
+  * Start a frequency chirp
+  *
+  * Set up a chirp and output the start frequency. The first step 
+  * is due one period after this method returns.
+  *
+  * \sa chirpStep(), chirpEnd()
+  *
+  * \param fStart  start frequency in Hz, less than half the reference clock frequency
+  * \param fEnd    end frequency in Hz, less than half the reference clock frequency
+  * \param steps   number of steps from start to end frequency
+  * \param period  time between steps in microseconds, used for the timing statistics
+  * \param type    frequency change defined by one of the chirp_t enumerations
+  * \return true if successful, false if the parameters are not valid or, for
+  * CHIRP_GEOMETRIC, if the ratio between steps is not between 0.5 and 1.5
+  */
+  boolean chirpBegin(float fStart, float fEnd, uint32_t steps, uint32_t period, chirp_t type = CHIRP_LINEAR);
+
+  /**
+  * Step the frequency chirp
+  *
+  * Work out and output the next frequency in the chirp. This method is
+  * short enough to be called from an interrupt service routine.
+  *
+  * \sa chirpBegin(), chirpEnd()
+  *
+  * \return true if a step was output, false if the chirp has completed
+  */
+  boolean chirpStep(void);
+
+  /**
+  * End the frequency chirp
+  *
+  * Stop the chirp, leaving the last frequency output, and restore 
+  * the device settings for the other library methods.
+  *
+  * \sa chirpBegin()
+  */
+  void chirpEnd(void);
+
+  /**
+  * Check if the chirp is running
+  *
+  * \return true if chirpStep() has steps left to output
+  */
+  inline boolean chirpRunning(void) { return(_chirpCount < _chirpSteps); }
+
+  /**
+  * Get the number of chirp steps output
+  *
+  * \return the number of steps output since chirpBegin()
+  */
+  inline uint32_t getChirpSteps(void) { return(_chirpCount); }
+
+  /**
+  * Get the achieved chirp update rate
+  *
+  * \sa getChirpError()
+  *
+  * \return the average number of steps per second since chirpBegin()
+  */
+  float getChirpRate(void);
+
+  /**
+  * Get the chirp timing error
+  *
+  * Get the largest difference between the time a step was output and
+  * the time it was due according to the chirp period.
+  *
+  * \sa getChirpRate()
+  *
+  * \return the largest timing error in microseconds
+  */
+  inline uint32_t getChirpError(void) { return(_chirpError); }
+
+  /** @} */
+
+  //--------------------------------------------------------------
+  /** \name Methods for AD9833 sequencer
+   *
+   * The sequencer runs a compact binary program of seqOp_t instructions
+   * to drive the AD9833 with deterministic timing. The frequency and phase
+   * are given as register values worked out before the program is run, 
+   * so the sequencer only needs to build and send the SPI words.
+   *
+   * Programs can be created using the AD9833_SeqAsm tool in the library 
+   * extras folder, which converts a text script into a binary file or a 
+   * PROGMEM array.
+   * @{
+   */
+  /**
+  * Run a sequencer program
+  *
+  * Run the program until the SEQ_END instruction. SEQ_WAIT times run 
+  * from the end of the previous SEQ_WAIT (or the start of the program),
+  * so the time taken by the instructions in between does not change 
+  * the program timing. Loops may be nested up to AD_SEQ_LOOP_DEPTH deep.
+  * 
+  * The program can be in PROGMEM or in RAM (eg, received from the 
+  * serial port). This method does not return until the program ends.
+  * Instructions are checked as they are run and the program stops at 
+  * the first invalid instruction (an unknown opcode, an argument out of
+  * range, a non-zero low nibble where there is no argument, or data past
+  * the end of the program) or if the end of the 
+  * program is reached without a SEQ_END. As for setSleep(), SEQ_SLEEP 
+  * is invalid while the mode is MODE_OFF.
+  *
+  * \param prog     pointer to the program
+  * \param len      length of the program in bytes (eg, sizeof() a PROGMEM array)
+  * \param progmem  true if the program is in PROGMEM, false if in RAM
+  * \return true if the program ended normally, false if an invalid instruction was found
+  */
+  boolean runSequence(const uint8_t* prog, uint16_t len, bool progmem = true);
+
+  /** @} */
+
+  //--------------------------------------------------------------
+  /** \name Methods for AD9833 register encoding
+   *
+   * These methods build the 16-bit SPI words for a register change into a
+   * buffer supplied by the caller and return the number of words written.
+   * They do not access the hardware or any object data, so the words can be
+   * sent to the device by other means (eg, a DMA transfer) and can be
+   * assembled for more than one device.
+   *
+   * Where the control register is involved, the caller keeps the control
+   * register image for the device and it is updated to match the words written.
+   * The buffer must be at least ENC_MAX_WORDS long.
+   * @{
+   */
+  static const uint8_t ENC_MAX_WORDS = 3; ///< Maximum number of words written by any encode method
+
+  /**
+  * Get the control register image
+  *
+  * Get the current value of the control register image for this device.
+  * This is the starting point for encoding changes to the device.
+  *
+  * \return the control register image
+  */
+  inline uint16_t getControl(void) { return _regCtl; }
+
+  /**
+  * Encode a frequency register write
+  *
+  * The control word is written with B28 set, followed by the 14 LSBs
+  * and the 14 MSBs of the frequency register value.
+  *
+  * \sa calcFreq()
+  *
+  * \param buf   buffer to receive the SPI words
+  * \param ctl   control register image, updated by the encoding
+  * \param chan  frequency register identifier (channel_t)
+  * \param reg   28-bit frequency register value
+  * \return the number of words written to buf (3)
+  */
+  static uint8_t encodeFrequency(uint16_t* buf, uint16_t &ctl, channel_t chan, uint32_t reg);
+
+  /**
+  * Encode a phase register write
+  *
+  * \sa calcPhase()
+  *
+  * \param buf   buffer to receive the SPI words
+  * \param chan  phase register identifier (channel_t)
+  * \param reg   12-bit phase register value
+  * \return the number of words written to buf (1)
+  */
+  static uint8_t encodePhase(uint16_t* buf, channel_t chan, uint16_t reg);
+
+  /**
+  * Encode a frequency register change
+  *
+  * Only the 14-bit halves of the register that change are written. The
+  * B28 and HLB control bits are set as needed, so a control word is 
+  * only written if they need to change.
+  *
+  * \sa encodeFrequency()
+  *
+  * \param buf     buffer to receive the SPI words
+  * \param ctl     control register image, updated by the encoding
+  * \param chan    frequency register identifier (channel_t)
+  * \param regOld  current 28-bit frequency register value
+  * \param regNew  new 28-bit frequency register value
+  * \return the number of words written to buf (0 to 3)
+  */
+  static uint8_t encodeFrequencyChange(uint16_t* buf, uint16_t &ctl, channel_t chan, uint32_t regOld, uint32_t regNew);
+
+  /**
+  * Encode an output mode change
+  *
+  * \sa setMode()
+  *
+  * \param buf   buffer to receive the SPI words
+  * \param ctl   control register image, updated by the encoding
+  * \param mode  wave output defined by one of the mode_t enumerations
+  * \return the number of words written to buf (1)
+  */
+  static uint8_t encodeMode(uint16_t* buf, uint16_t &ctl, mode_t mode);
+
+  /**
+  * Encode an output frequency channel selection
+  *
+  * \sa setActiveFrequency()
+  *
+  * \param buf   buffer to receive the SPI words
+  * \param ctl   control register image, updated by the encoding
+  * \param chan  output channel identifier (channel_t)
+  * \return the number of words written to buf (1)
+  */
+  static uint8_t encodeActiveFrequency(uint16_t* buf, uint16_t &ctl, channel_t chan);
+
+  /**
+  * Encode an output phase channel selection
+  *
+  * \sa setActivePhase()
+  *
+  * \param buf   buffer to receive the SPI words
+  * \param ctl   control register image, updated by the encoding
+  * \param chan  output channel identifier (channel_t)
+  * \return the number of words written to buf (1)
+  */
+  static uint8_t encodeActivePhase(uint16_t* buf, uint16_t &ctl, channel_t chan);
+
+  /**
+  * Encode a hardware reset
+  *
+  * \sa reset()
+  *
+  * \param buf   buffer to receive the SPI words
+  * \param ctl   control register image, updated by the encoding
+  * \param hold  true to leave the device held in reset
+  * \return the number of words written to buf (1 if hold, 2 otherwise)
+  */
+  static uint8_t encodeReset(uint16_t* buf, uint16_t &ctl, bool hold);
+
+  /**
+  * Encode a power state change
+  *
+  * \sa setSleep()
+  *
+  * \param buf    buffer to receive the SPI words
+  * \param ctl    control register image, updated by the encoding
+  * \param state  power state defined by one of the sleep_t enumerations
+  * \return the number of words written to buf (1)
+  */
+  static uint8_t encodeSleep(uint16_t* buf, uint16_t &ctl, sleep_t state);
+
+  /**
+  * Calculate a frequency register value
+  *
+  * Convert a frequency into the 28-bit value for a frequency register,
+  * correctly rounded to the nearest value for reference clocks of 
+  * 8388608 Hz (2^23) or more. Only integer shift and subtract operations
+  * are used, taking fewer steps for lower frequencies.
+  *
+  * \param f     frequency in Hz
+  * \param mClk  AD9833 reference clock frequency in Hz
+  * \return the frequency register value
+  */
+  static uint32_t calcFreq(float f, uint32_t mClk);
+
+  /**
+  * Calculate a frequency register value from millihertz
+  *
+  * Convert a frequency in millihertz into the 28-bit value for a frequency
+  * register, correctly rounded to the nearest value. Only integer shift 
+  * and subtract operations are used.
+  *
+  * \param mHz   frequency in millihertz, less than the reference clock frequency
+  * \param mClk  AD9833 reference clock frequency in Hz
+  * \return the frequency register value
+  */
+  static uint32_t calcFreqmHz(uint64_t mHz, uint32_t mClk);
+
+  /**
+  * Calculate the frequency for a register value
+  *
+  * Convert a 28-bit frequency register value into the frequency produced
+  * by the AD9833, rounded to the nearest millihertz.
+  *
+  * \param reg   28-bit frequency register value
+  * \param mClk  AD9833 reference clock frequency in Hz
+  * \return the output frequency in millihertz
+  */
+  static uint64_t calcActualmHz(uint32_t reg, uint32_t mClk);
+
+  /**
+  * Calculate a phase register value
+  *
+  * Convert a phase angle into the 12-bit value for a phase register.
+  *
+  * \param a   phase in tenths of a degree [0..3600]
+  * \return the phase register value
+  */
+  static uint16_t calcPhase(float a);
+
+  /** @} */
+
 private:
   // Hardware register images
   uint16_t  _regCtl;       // control register image
@@ -361,17 +908,45 @@ private:
   uint16_t  _phase[2];    // last phase setting
   uint32_t  _mClk;        // reference clock frequency
 
+  // Tuning table
+  const tuneEntry_t* _tuneTable;  // PROGMEM table of replacement frequency registers
+  uint16_t  _tuneSize;            // number of entries in the table
+
+  // Power state statistics
+  uint32_t  _sleepTime[4];  // total time in each sleep_t state (ms)
+  uint32_t  _sleepStart;    // millis() at the start of the current state
+  uint32_t  _wakeLatency;   // last wake up time (us)
+  uint32_t  _wakeCount;     // number of wake ups
+
+  // Chirp data
+  chirp_t   _chirpType;     // type of frequency change
+  int64_t   _chirpAcc;      // frequency register value, 28.32 fixed point
+  int64_t   _chirpInc;      // linear increment per step, 28.32 fixed point
+  int64_t   _chirpRatio;    // geometric ratio - 1 per step, 56 bit fixed point
+  uint32_t  _chirpEnd;      // final frequency register value
+  uint32_t  _chirpSteps;    // total number of steps
+  uint32_t  _chirpCount;    // steps completed
+  uint32_t  _chirpPeriod;   // time between steps (us)
+  uint32_t  _chirpStart;    // micros() at chirp start
+  uint32_t  _chirpLast;     // micros() at the last step
+  uint32_t  _chirpError;    // largest step timing error (us)
+
   // SPI interface data
   uint8_t _dataPin;     // DATA is shifted out of this pin ...
   uint8_t _clkPin;      // ... signaled by a CLOCK on this pin ...
   uint8_t	_fsyncPin;    // ... and LOADed when the fsync pin is driven HIGH to LOW
   bool    _hardwareSPI; // true if SPI interface is the hardware interface
-  
-  // Convenience calculations
-  uint32_t calcFreq(float f); // Calculate AD9833 frequency register from a frequency
-  uint16_t calcPhase(float a);// Calculate AD9833 phase register from phase
 
-  // SPI related 
+  // Convenience calculations
+  static uint32_t divRound(uint32_t q, uint32_t r, uint32_t d, uint8_t bits); // long division for register values
+  static int64_t mulQ56(int64_t a, int64_t b);  // 56 bit fixed point multiply for the chirp ratio
+  static int64_t lnQ56(uint32_t n);             // 56 bit fixed point natural log for the chirp ratio
+  uint32_t tuneFreq(uint32_t reg);  // apply the tuning table to a frequency register value
+  void sleepTrack(void);            // account the time spent in the current power state
+  static uint32_t seqRead(const uint8_t* &p, uint8_t len, bool progmem); // read sequencer data bytes
+
+  // SPI related
   void dumpCmd(uint16_t reg);       // debug routine
   void spiSend(uint16_t data);      // do the actual physical communications task
+  void spiSend(const uint16_t* buf, uint8_t count); // send a buffer of encoded words
 };
@@ -33,6 +33,9 @@ See the main header file for full information
 #ifndef AD_DEFAULT_PHASE
 #define AD_DEFAULT_PHASE  0     ///< Default initialization phase angle (degrees)
 #endif
+#ifndef AD_SEQ_LOOP_DEPTH
+#define AD_SEQ_LOOP_DEPTH 4     ///< Maximum depth of nested sequencer loops
+#endif
 
 /** @}*/ 
 
@@ -93,3 +96,12 @@ const uint8_t AD_PHASE = 13;    ///< Select the phase register
 #define AD_2POW28 (1UL << 28) ///< Used when calculating output frequency
 
 /** @} */
+
+/** \name Fixed point constants for the geometric chirp ratio, 56 fraction bits
+* @{ */
+#define AD_Q56_ONE    (1LL << 56)           ///< 1
+#define AD_Q56_LN2    49946518145322874LL   ///< ln(2)
+#define AD_Q56_LN1_5  29216840156602672LL   ///< ln(1.5)
+#define AD_Q56_SQRT2  101904826760412361LL  ///< sqrt(2)
+
+/** @} */